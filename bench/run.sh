@@ -0,0 +1,27 @@
+#!/bin/sh
+# benchmark suite of the scheduler, run from the repository root with make bench
+# for each size and arrival distribution a synthetic workload is generated and simulated with -S, one row is printed per run
+# sizes are set with BENCH_SIZES, cores with BENCH_CORES (arrival rate grows with them so every core stays 90% busy)
+# compare rows of two commits to find regressions in the scheduler core
+
+set -e
+
+sizes=${BENCH_SIZES:-"100 1000 10000 100000 1000000 10000000"}
+cores=${BENCH_CORES:-4}
+root=$(pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cp instructions.txt "$work"
+
+printf "%-10s %-8s %12s %12s %10s %10s %14s %16s %12s\n" processes arrival events dispatches load_ms run_ms events_per_s ns_per_dispatch peak_rss_kb
+for n in $sizes; do
+    for arrival in poisson bursty; do
+        "$root/bench/workloadgen" -n "$n" -a "$arrival" -u "$(awk "BEGIN { print 0.9 * $cores }")" -l 2:12 -i instructions.txt -o "$work"
+        stats=$(cd "$work" && "$root/scheduler" -c "$cores" -S 2>&1 >/dev/null)
+        echo "$stats" | awk -v arrival="$arrival" '{
+            for (i = 1; i < NF; i += 2) value[$i] = $(i + 1)
+            printf "%-10s %-8s %12s %12s %10s %10s %14s %16s %12s\n", value["processes"], arrival, value["events"], value["dispatches"],
+                value["load_ms"], value["run_ms"], value["events_per_s"], value["ns_per_dispatch"], value["peak_rss_kb"]
+        }'
+    done
+done
@@ -0,0 +1,236 @@
+// necessary headers
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+// synthetic workload generator for the benchmark suite
+// it writes definition.txt and programs B1.txt, B2.txt, ... into a directory, using instruction names from instructions.txt
+// the same seed and options always give the same workload
+
+// splitmix64 generator, enough for workloads and the same on every platform
+uint64_t rng_state;
+
+uint64_t next_random() {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// uniform double in [0, 1)
+double random_unit() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// uniform integer in [low, high]
+int random_between(int low, int high) {
+    return low + (int)(next_random() % (uint64_t)(high - low + 1));
+}
+
+// exponentially distributed value with given mean, gaps between poisson arrivals
+double random_exponential(double mean) {
+    return -mean * log(1.0 - random_unit());
+}
+
+// instruction set read from instructions.txt, exit is not used inside programs
+// I/O instructions (a line with a device after the burst time) are only used with -x
+char (*instruction_names)[32] = NULL;
+int *instruction_bursts = NULL;
+int *instruction_io = NULL; // 1 for an I/O instruction, its burst time is the service time of the device and does not use the CPU
+int instruction_count = 0;
+int exit_burst = 0;
+
+// reads instructions.txt line by line, each line is "name burst [device [track]]", I/O instructions are kept only if use_io is set
+void load_instructions(const char *path, int use_io) {
+    FILE *filepointer = fopen(path, "r");
+    if (filepointer == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    char line[256];
+    int line_number = 0;
+    int capacity = 0;
+    while (fgets(line, sizeof(line), filepointer) != NULL) {
+        line_number++;
+        char name[32], device[32];
+        int burst;
+        int fields = sscanf(line, "%31s %d %31s", name, &burst, device);
+        if (fields == EOF) { // blank line
+            continue;
+        }
+        if (fields < 2) {
+            fprintf(stderr, "%s:%d: expected name burst [device [track]]\n", path, line_number);
+            exit(EXIT_FAILURE);
+        }
+        int io = fields == 3;
+        if (strcmp(name, "exit") == 0) {
+            exit_burst = burst;
+            continue;
+        }
+        if (io && !use_io) {
+            continue;
+        }
+        if (instruction_count == capacity) {
+            capacity = capacity ? capacity * 2 : 32;
+            instruction_names = realloc(instruction_names, capacity * sizeof(*instruction_names));
+            instruction_bursts = realloc(instruction_bursts, capacity * sizeof(int));
+            instruction_io = realloc(instruction_io, capacity * sizeof(int));
+            if (instruction_names == NULL || instruction_bursts == NULL || instruction_io == NULL) {
+                exit(EXIT_FAILURE);
+            }
+        }
+        strcpy(instruction_names[instruction_count], name);
+        instruction_bursts[instruction_count] = burst;
+        instruction_io[instruction_count++] = io;
+    }
+    fclose(filepointer);
+    if (instruction_count == 0) {
+        fprintf(stderr, "%s has no instructions\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// opens path in directory for writing
+FILE *create_file(const char *directory, const char *name) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE *filepointer = fopen(path, "w");
+    if (filepointer == NULL) {
+        fprintf(stderr, "cannot create %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    return filepointer;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "usage: %s -n processes [-a poisson|bursty] [-b burst_size] [-u utilization] [-m platinum:gold:silver]\n"
+                    "       [-k programs] [-l min:max] [-s seed] [-i instructions] [-x] [-o directory]\n", program);
+    exit(EXIT_FAILURE);
+}
+
+/* main function writes a workload of -n processes
+-a is the arrival distribution, poisson arrivals have exponential gaps, bursty arrivals come in groups of -b processes at the same time
+-u is the offered load of a single core, the mean gap between arrivals is the mean program time divided by it
+-m is the weight of each class, -k the number of distinct programs and -l the range of their lengths in instructions
+-x mixes the I/O instructions of instructions.txt into programs, by default programs only use CPU instructions */
+int main(int argc, char *argv[]) {
+
+    long long process_count = -1;
+    int bursty = 0;
+    int burst_size = 50;
+    double utilization = 0.9;
+    int weights[3] = {1, 3, 6}; // platinum, gold, silver
+    int program_count = 10;
+    int min_length = 5, max_length = 40;
+    uint64_t seed = 1;
+    const char *instructions_path = "instructions.txt";
+    const char *directory = ".";
+    int use_io = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:a:b:u:m:k:l:s:i:xo:")) != -1) {
+        switch (option) {
+        case 'n':
+            process_count = atoll(optarg);
+            break;
+        case 'a':
+            if (strcmp(optarg, "poisson") == 0) {
+                bursty = 0;
+            } else if (strcmp(optarg, "bursty") == 0) {
+                bursty = 1;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'b':
+            burst_size = atoi(optarg);
+            break;
+        case 'u':
+            utilization = atof(optarg);
+            break;
+        case 'm':
+            if (sscanf(optarg, "%d:%d:%d", &weights[0], &weights[1], &weights[2]) != 3) {
+                usage(argv[0]);
+            }
+            break;
+        case 'k':
+            program_count = atoi(optarg);
+            break;
+        case 'l':
+            if (sscanf(optarg, "%d:%d", &min_length, &max_length) != 2) {
+                usage(argv[0]);
+            }
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'i':
+            instructions_path = optarg;
+            break;
+        case 'x':
+            use_io = 1;
+            break;
+        case 'o':
+            directory = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (process_count < 0 || burst_size < 1 || utilization <= 0 || program_count < 1 || program_count > 99999
+        || min_length < 1 || max_length < min_length || weights[0] < 0 || weights[1] < 0 || weights[2] < 0
+        || weights[0] + weights[1] + weights[2] == 0) {
+        usage(argv[0]);
+    }
+    rng_state = seed;
+    load_instructions(instructions_path, use_io);
+
+    // programs, the mean of their total CPU burst times sets the arrival rate
+    double total_burst = 0;
+    for (int k = 1; k <= program_count; k++) {
+        char name[32];
+        snprintf(name, sizeof(name), "B%d.txt", k);
+        FILE *program = create_file(directory, name);
+        int length = random_between(min_length, max_length);
+        for (int i = 0; i < length; i++) {
+            int instruction = random_between(0, instruction_count - 1);
+            fprintf(program, "%s\n", instruction_names[instruction]);
+            if (!instruction_io[instruction]) {
+                total_burst += instruction_bursts[instruction];
+            }
+        }
+        fprintf(program, "exit\n");
+        total_burst += exit_burst;
+        fclose(program);
+    }
+    double mean_gap = total_burst / program_count / utilization;
+
+    // processes in arrival order
+    static const char *types[3] = {"PLATINUM", "GOLD", "SILVER"};
+    int weight_sum = weights[0] + weights[1] + weights[2];
+    FILE *definition = create_file(directory, "definition.txt");
+    double time = 0;
+    for (long long p = 0; p < process_count; p++) {
+        if (!bursty) {
+            time += random_exponential(mean_gap);
+        } else if (p % burst_size == 0) {
+            time += random_exponential(mean_gap * burst_size);
+        }
+        if (time > 2000000000) {
+            fprintf(stderr, "arrival times do not fit in an int, use fewer processes or a higher utilization\n");
+            exit(EXIT_FAILURE);
+        }
+        int draw = random_between(0, weight_sum - 1);
+        int type = draw < weights[0] ? 0 : draw < weights[0] + weights[1] ? 1 : 2;
+        fprintf(definition, "p%lld %d %d %s B%d\n", p + 1, random_between(1, 10), (int)time, types[type], random_between(1, program_count));
+    }
+    fclose(definition);
+
+    free(instruction_names);
+    free(instruction_bursts);
+    free(instruction_io);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+// embedding interface of the scheduler, built into libscheduler.a and libscheduler.so by make lib
+// a program links the library and drives simulations in its own process instead of writing definition files and parsing output
+// the instruction set, devices, programs and configuration are shared by all contexts, they are set up before contexts are created
+// and not changed while contexts run, contexts are independent so each thread can run its own
+// everything is kept in memory, a program that is not added with scheduler_add_program is read from <name>.txt when a process first uses it
+#ifndef LIBSCHEDULER_H
+#define LIBSCHEDULER_H
+
+#if defined(__GNUC__)
+#define SCHEDULER_API __attribute__((visibility("default")))
+#else
+#define SCHEDULER_API
+#endif
+
+// simulation context, it holds the processes, cores and device queues of one simulation
+typedef struct SchedulerContext SchedulerContext;
+
+// results of the processes that terminated so far
+typedef struct {
+    int time; // time every process that arrives later can be added at, see scheduler_time
+    int exited; // number of terminated processes
+    int remaining; // number of processes that did not terminate yet
+    long long total_waiting_time; // total waiting time of terminated processes
+    long long total_turnaround_time; // total turnaround time of terminated processes
+    double average_waiting_time; // 0 if no process terminated
+    double average_turnaround_time; // 0 if no process terminated
+    int makespan; // time the last process terminated
+    long long events; // iterations of the simulation loop
+    long long context_switches; // context switches of all cores
+    long long busy_time; // time all cores spent executing instructions
+} SchedulerMetrics;
+
+// sets configuration key (context_switch, gold_quantum, ... as in a configuration file) to value
+// returns 0, -1 if the key is unknown and -2 if the value is out of range
+SCHEDULER_API int scheduler_set_config(const char *key, int value);
+
+// adds a device or changes an existing one, requests are served in request order or in elevator order with seek_time per track
+// returns 0, -1 if the name is too long or seek_time is negative
+SCHEDULER_API int scheduler_add_device(const char *name, int elevator, int seek_time);
+
+// adds an instruction to the instruction set, device is NULL for a CPU instruction, otherwise an I/O instruction accesses track of it
+// an unknown device is added as a fifo device, returns 0, -1 if the instruction exists, a name is too long or a time is negative
+SCHEDULER_API int scheduler_add_instruction(const char *name, int burst, const char *device, int track);
+
+// adds a program of length instructions named in instructions, it must end with a CPU instruction (exit)
+// returns 0, -1 if the program exists, its name is too long, an instruction is unknown or the program is empty or ends with I/O
+SCHEDULER_API int scheduler_add_program(const char *name, const char *const *instructions, int length);
+
+// creates a context with core_count cores scheduling with the named policy (priority, fcfs, sjf, srtf, mlfq, cfs or lottery)
+// returns NULL if the core count or the policy is invalid
+SCHEDULER_API SchedulerContext *scheduler_create(int core_count, const char *policy);
+
+// frees a context and everything it allocated
+SCHEDULER_API void scheduler_destroy(SchedulerContext *context);
+
+// removes every process of the context so a new run starts at time 0, allocated memory is kept for the next run
+SCHEDULER_API void scheduler_reset(SchedulerContext *context);
+
+// adds a process arriving at time arrival, type is PLATINUM, GOLD or SILVER and program is the name of its program
+// a process must be added before the context is simulated past its arrival, so arrival is at least scheduler_time
+// returns 0, -1 if the name is too long, the type is unknown, arrival is too early or after 1073741823 (half of the clock range),
+// or the program is not added and <program>.txt cannot be read or is not valid (an instruction is unknown, it is empty or ends with I/O),
+// nothing is added then
+SCHEDULER_API int scheduler_add_process(SchedulerContext *context, const char *name, int priority, int arrival, const char *type, const char *program);
+
+// simulates until every core reached time or every process terminated, a core may be past time after its last instruction
+// returns the number of processes that did not terminate yet
+SCHEDULER_API int scheduler_run_until(SchedulerContext *context, int time);
+
+// simulates a single iteration of the simulation loop (a dispatch, a continuation or an idle core waking up)
+// returns the number of processes that did not terminate yet, nothing is simulated if it is 0
+SCHEDULER_API int scheduler_step(SchedulerContext *context);
+
+// returns the latest time a core of the context reached, processes arriving at or after it can still be added
+SCHEDULER_API int scheduler_time(const SchedulerContext *context);
+
+// fills metrics with the results of the context so far
+SCHEDULER_API void scheduler_collect(const SchedulerContext *context, SchedulerMetrics *metrics);
+
+#endif
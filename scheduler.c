@@ -5,1398 +5,3638 @@
 #include <stdlib.h> 
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <time.h>
 #include <sys/sysinfo.h>
 #include <dirent.h>
 #include <stdbool.h> 
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
 #include <fcntl.h> 
 #include <math.h>
+#include <pthread.h>
 
+#include "trace.h"
+#include "libscheduler.h"
 
-// lets define instruction burst times
-#define instr1 90;
-#define instr2 80;
-#define instr3 70;
-#define instr4 60;
-#define instr5 50;
-#define instr6 40;
-#define instr7 30;
-#define instr8 20;
-#define instr9 30;
-#define instr10 40;
-#define instr11 50;
-#define instr12 60;
-#define instr13 70;
-#define instr14 80;
-#define instr15 90;
-#define instr16 80;
-#define instr17 70;
-#define instr18 60;
-#define instr19 50;
-#define instr20 40;
-#define instr_exit 10;
-
-// define context switch time
-int context_switch = 10; 
-
-// lets define process types
-int p1_len = 12; 
-int p1[12] = {90, 50, 90, 60, 70, 80, 40, 90, 60, 70, 80, 10}; // 790
-int p2_len = 9;
-int p2[9] = {60, 80, 50, 40, 50, 40, 50, 40, 10}; // 420 
-int p3_len = 10;
-int p3[10] = {20, 30, 60, 50, 70, 80, 50, 20, 30, 10} ; // 420
-int p4_len = 6;
-int p4[6] = {30, 80, 50, 30, 80, 10}; // 280
-int p5_len = 11;
-int p5[11] = {30, 80, 50, 30, 80, 80, 50, 30, 80, 50, 10}; // 570
-int p6_len = 15;
-int p6[15] = {40, 30, 40, 50, 60, 50, 30, 40, 30, 40, 50, 60, 50, 30, 10}; // 610
-int p7_len = 6;
-int p7[6] = {20, 90, 40, 50, 80, 10}; // 290
-int p8_len = 5;
-int p8[5] = {80, 60, 70, 90, 10}; // 310
-int p9_len = 6;
-int p9[6] = {50, 60, 30, 90, 30, 10}; // 270
-int p10_len = 10; 
-int p10[10] = {40, 70, 50, 50, 80, 50, 20, 70, 80, 10}; // 520 
-
-// lets define quantum times for different types (GOLD, SILVER)
-#define silver_quantum 80;
-#define gold_quantum 120;
-
-// Process structure
+
+// I/O devices, read from devices.txt if it exists (name, fifo or elevator and seek time of each device)
+// a device serves one request at a time, processes that wait for it are blocked and do not use a CPU
 typedef struct {
-    char name[10]; // P1, P2, ... P10
-    int priority; // priority of the process
-    int arrival_time; // arrival to system
-    int secondary_arrival; // in case that process escalates (silver -> gold or gold -> platinum)
-    int completion_time; // termination time
-    char type[10]; // silver, gold or platinum
-    int PC; // program counter
-    int quantum_counter; // number of times the process entered to CPU
-    int duration; // total time process is executed (equals to sum of all instruction times when terminated)
-    int enter_to_ready; // time of entering to ready queue, it is updated during execution and used to handle round robin
-} Process;
-
-Process processes[10]; // process array, max 10 processes are expected
-int process_count = 0; // number of processes in processes array
-
-Process exited_processes[10]; // terminated processes
-int exited_process_count = 0; // number of terminated processes
-Process ready_processes[10]; // ready queue
-int ready_process_count = 0; // number of ready processes in ready queue
-
-int global_time = 0; // current time
-
-char lep[10] = "";  // last executed process name
-int ongoing_quantum = 0; // stores the execution time during last quantum in the system, it is used to update quantum counter and enter_to_ready field of processes
-
-// prints some fields of processes for debugging purposes
-void printProcess(Process *process) {
-    printf("Name: %s, Pri: %d, Quantum: %d, Arrival: %d, Type: %s PC: %d Duration: %d\n", process->name, process->priority, process->quantum_counter, process->enter_to_ready, process->type, process->PC, process->duration); 
-}
-
-// comparison function used in qsort function, priorities are arranged in order -> (platinum - high priority - early arrival to ready queue - name(str comparison))
-int cmp(const void *left, const void*right) {
-    
-    const Process *a = (const Process *)left;
-    const Process *b = (const Process *)right;
+    char name[32]; // disk, network, ...
+    int elevator; // 1 if requests are served in elevator order of their tracks, 0 if they are served in request order
+    int seek_time; // time to move the head of the device by one track
+} Device;
 
-    // platinum process has higher priority over other types
-    if (strcmp(a->type, "PLATINUM") == 0 && strcmp(b->type, "PLATINUM") != 0 ) {
+Device *devices = NULL; // devices, devices used by instructions but not listed in devices.txt are fifo without seek time
+int device_count = 0; // number of devices
 
-        return -1; 
+// instruction set, read from instructions.txt (name and burst time of each instruction)
+// an I/O instruction also names its device and optionally a track, its burst time is the service time of the device
+typedef struct {
+    char name[32]; // instr1, instr2, ... exit
+    int burst; // burst time of the instruction
+    int device; // device index of an I/O instruction, -1 for a CPU instruction
+    int track; // track of the device an I/O instruction accesses
+} Instruction;
+
+Instruction *instructions = NULL; // instruction set
+int instruction_count = 0; // number of instructions in instruction set
+int instruction_capacity = 0; // allocated size of instructions array
+
+// program structure, burst times of the instructions of a program and their prefix sums are stored in one block with it
+// programs are never moved or freed after they are loaded, so simulations running in other threads can keep pointers to them
+typedef struct {
+    char name[32]; // P1, P2, ... (program is read from <name>.txt)
+    int length; // number of instructions including exit
+    int *bursts; // burst times of the instructions, service time of the device for I/O instructions, length entries
+    // prefix sums of CPU burst times, prefix[i] is the total burst time of the CPU instructions among the first i, length + 1 entries
+    // they make remaining burst and quantum end lookups O(1) / O(log n) instead of loops over instructions
+    int *prefix; 
+    int *instruction; // index of each instruction in the instruction set, length entries
+    // next_io[i] is the first I/O instruction at or after i, length if there is none, length + 1 entries
+    // a process runs on the CPU until its next I/O instruction at most, then it blocks on the device
+    int *next_io;
+    int data[]; // storage of bursts, prefix, instruction and next_io
+} Program;
+
+Program **programs = NULL; // loaded programs, used to find a program by its name
+int program_count = 0; // number of loaded programs
+int program_capacity = 0; // allocated size of programs array
+pthread_mutex_t program_lock = PTHREAD_MUTEX_INITIALIZER; // programs are loaded while definition files are read in several threads
+
+// process types, type strings are only parsed when processes are read
+typedef enum {
+    PLATINUM, // runs atomically, always scheduled before other types
+    GOLD, // round robin, promoted to platinum
+    SILVER, // round robin, promoted to gold
+    TYPE_COUNT
+} ProcessType;
+
+// scheduling policy of each process type
+typedef struct {
+    const char *name; // type string in definition.txt
+    int quantum; // allowed quantum time, 0 if process runs atomically
+    int promotion; // number of quanta spent in this type before promotion, 0 if it is never promoted
+    ProcessType promoted_to; // type after promotion
+} TypePolicy;
 
-    // platinum process has higher priority over other types
-    } else if (strcmp(a->type, "PLATINUM") != 0 && strcmp(b->type, "PLATINUM") == 0 ){
+#define MLFQ_LEVELS 3 // levels of the multilevel feedback queue policy
 
-        return 1;
+// configuration of the scheduler, defaults are the values of the project description
+// it is read from a file with -f option and single values are set with -o key=value before any simulation starts,
+// so it is shared by all simulations and it is not changed while simulations run
+typedef struct {
+    int context_switch; // time of a context switch
+    TypePolicy types[TYPE_COUNT]; // policy table indexed by ProcessType
+    int mlfq_quanta[MLFQ_LEVELS]; // quantum of each level, new processes start at level 0
+    int slice; // time slice of CFS and lottery
+    int checkpoint_interval; // smallest number of events between two checkpoints of a what-if run
+} Config;
+
+Config config = {
+    .context_switch = 10,
+    .types = {
+        [PLATINUM] = {"PLATINUM", 0, 0, PLATINUM},
+        [GOLD] = {"GOLD", 120, 5, PLATINUM},
+        [SILVER] = {"SILVER", 80, 3, GOLD},
+    },
+    .mlfq_quanta = {80, 160, 320},
+    .slice = 100,
+    .checkpoint_interval = 4096,
+};
+
+// configuration keys and the smallest value each one accepts, a quantum of 0 makes processes of the type run to completion
+// and a promotion of 0 turns promotion of the type off, platinum is the highest type so it has no promotion key
+static const struct {
+    const char *key;
+    int *value;
+    int minimum;
+} config_keys[] = {
+    {"context_switch", &config.context_switch, 0},
+    {"platinum_quantum", &config.types[PLATINUM].quantum, 0},
+    {"gold_quantum", &config.types[GOLD].quantum, 0},
+    {"silver_quantum", &config.types[SILVER].quantum, 0},
+    {"gold_promotion", &config.types[GOLD].promotion, 0},
+    {"silver_promotion", &config.types[SILVER].promotion, 0},
+    {"mlfq_quantum1", &config.mlfq_quanta[0], 1},
+    {"mlfq_quantum2", &config.mlfq_quanta[1], 1},
+    {"mlfq_quantum3", &config.mlfq_quanta[2], 1},
+    {"slice", &config.slice, 1},
+    {"checkpoint_interval", &config.checkpoint_interval, 1},
+};
+
+// scheduling policies, a policy orders the ready queues with its key, sets the time slice of each process and
+// updates processes when they arrive, are selected, run, use up their quantum or are preempted
+// hooks take the policy as a constant and are always inlined, run_simulation instantiates the simulation loop once per
+// policy, so the loop has no indirect calls and each instance only contains the code of its own policy
+typedef enum {
+    POLICY_PRIORITY, // platinum, gold and silver classes with priorities and round robin (the project policy)
+    POLICY_FCFS, // first come first served, processes run to completion in arrival order
+    POLICY_SJF, // shortest job first, the process with the shortest program runs to completion
+    POLICY_SRTF, // shortest remaining time first, an arrival with less remaining time preempts the running process
+    POLICY_MLFQ, // multilevel feedback queue, a process that uses up its quantum is demoted to a level with a longer quantum
+    POLICY_CFS, // completely fair, the process with the smallest virtual runtime (weighted by priority) runs for a slice
+    POLICY_LOTTERY, // each slice is won by a ready process with probability proportional to its tickets (priority)
+    POLICY_COUNT
+} PolicyKind;
+
+static const char *const policy_names[POLICY_COUNT] = {"priority", "fcfs", "sjf", "srtf", "mlfq", "cfs", "lottery"};
+
+// latest arrival time, the simulation clock is an int and half of its range is kept for the work done after the last arrival
+#define MAX_ARRIVAL_TIME (INT_MAX / 2)
+
+// process table, fields of processes are stored in separate arrays (struct of arrays) 
+// so ordering and update loops only touch the fields they use, arrays grow as processes are read
+typedef struct {
+    char (*name)[PROCESS_NAME_SIZE]; // P1, P2, ... P10
+    int *priority; // priority of the process
+    int *arrival_time; // arrival to system
+    int *secondary_arrival; // in case that process escalates (silver -> gold or gold -> platinum)
+    int *completion_time; // termination time
+    unsigned char *type; // ProcessType (silver, gold or platinum)
+    unsigned char *defined_type; // type given in the definition file, type changes when the process is promoted
+    int *PC; // program counter
+    int *quantum_counter; // number of times the process entered to CPU
+    int *duration; // total time process is executed (equals to sum of all instruction times when terminated)
+    int *enter_to_ready; // time of entering to ready queue, it is updated during execution and used to handle round robin
+    const Program **program; // program of the process
+    int *promotion_at; // quantum counter value at which process is promoted to the next type
+    uint64_t *name_key; // process name packed by pack_name
+    int *first_run; // time the process first started executing, -1 before that
+    int *switch_count; // number of context switches to the process
+    int (*promotion_time)[TYPE_COUNT]; // time the process was promoted to each type, -1 if it was not
+    uint64_t *policy_state; // state of the process in the scheduling policy: MLFQ level, CFS virtual runtime or lottery pass
+    int *blocked_at; // time of the last I/O request of the process
+    int *io_time; // total time the process was blocked on devices, waiting for them or being served
+    int count; // number of processes in process table
+    int capacity; // allocated size of each array
+} ProcessTable;
+
+// ready queue entry, it carries the ordering key of the process so heap operations do not touch the process table
+typedef struct {
+    uint64_t key; // ordering key built by ready_key, smaller key is scheduled first
+    uint64_t name_key; // first 8 characters of process name packed by pack_name, used when keys are equal
+    int process; // index of the process in process table
+} ReadyEntry;
 
-    } else { // both not platinum or both platinum 
+// CPU core, each core has its own ready queue, clock and quantum state
+typedef struct {
+    // ready queue is a binary min-heap of entries ordered by their keys, so the scheduled process is always on top
+    ReadyEntry *ready_heap; // heap of ready entries
+    int ready_process_count; // number of ready processes in ready queue of the core
 
-        // high priority comes before low priority
-        if (a->priority > b->priority) {
+    int time; // current time of the core, INT_MAX when the core has nothing left to do
 
-            return -1;
+    int lep;  // last executed process index on this core, -1 until the first execution
+    int ongoing_quantum; // stores the execution time during last quantum on the core, it is used to update quantum counter and enter_to_ready field of processes
 
-        // high priority comes before low priority
-        } else if (a->priority < b->priority) {
+    // accounting
+    int context_switches; // number of context switches made by the core
+    int context_switch_time; // total time spent on context switches
+    int busy_time; // total time spent on executing instructions
+    int steals; // number of processes taken from ready queues of other cores
 
-            return 1;
+    uint64_t virtual_time; // CFS minimum virtual runtime or lottery pass of the last winner on the core
+} Core;
 
-        } else { // equal priority
+// requests of a device in one simulation, blocked processes are kept in an array sorted by their request time
+// requests of all cores before a time are known once every core reached it, so a request is started only then
+typedef struct {
+    int *queue; // blocked processes waiting for the device, from begin to begin + count
+    int begin; // position of the oldest request in queue
+    int count; // number of waiting requests
+    int capacity; // allocated size of queue
+    int serving; // process being served, -1 if the device is idle
+    int free_at; // time the request in service completes, or the last request completed if the device is idle
+    int head; // track of the last request
+    int direction; // direction the elevator moves on tracks, 1 or -1
+    int busy_time; // total service time including seeks
+    int requests; // number of served requests
+} DeviceQueue;
+
+typedef struct DefinitionStream DefinitionStream;
+typedef struct CheckpointLog CheckpointLog;
+
+// log-bucketed quantile sketch (as DDSketch), an observation x > 0 is counted in bucket ceil(log(x) / log(gamma)) where
+// gamma = (1 + QUANTILE_ACCURACY) / (1 - QUANTILE_ACCURACY), so the bucket midpoint is within QUANTILE_ACCURACY of every value in it
+// every quantile is answered from the same counts in one pass and constant memory, within that relative error of the exact one
+#define QUANTILE_ACCURACY 0.005
+#define QUANTILE_BUCKETS 2160 // log(INT_MAX) / log(gamma) is about 2149
+typedef struct {
+    long long count; // number of observations
+    long long zero; // observations of 0 or less, times are whole numbers so they are exact
+    long long bucket[QUANTILE_BUCKETS];
+} QuantileSketch;
 
-            // if priorities are equal, process came to ready queue first should be scheduled first 
-            // (!!! note that not arrival to system, after a process run for a quantum, its enter to ready queue is updated)
-            if (a->enter_to_ready < b->enter_to_ready) {
+// latency metrics of terminated processes
+#define QUANTILE_COUNT 3
+static const double quantile_levels[QUANTILE_COUNT] = {0.50, 0.95, 0.99};
 
-                return -1;
+typedef struct {
+    FILE *csv; // one row per terminated process, NULL if rows are not written
+    QuantileSketch waiting; // waiting time
+    QuantileSketch turnaround; // turnaround time
+    QuantileSketch response; // response time (first execution - arrival)
+} Metrics;
+
+// opt-in instrumentation, build with -DSCHEDULER_PROFILE (make scheduler_profile) to count hot path events and time phases in cycles
+// without it the macros expand to nothing and the profile does not exist, so the default build pays nothing
+#ifdef SCHEDULER_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define profile_cycles() __rdtsc()
+#else
+// nanoseconds stand in for cycles where there is no time stamp counter
+static inline uint64_t profile_cycles() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
 
-            // if priorities are equal, process came to ready queue first should be scheduled first 
-            } else if (a->enter_to_ready > b->enter_to_ready) {
+// counters and timers of the profile, the report and merging of profiles go over these lists
+#define PROFILE_COUNTERS(X) X(arrivals) X(executions) X(context_switches) X(preemptions) X(promotions) X(exits) \
+    X(blocks) X(idle_wakeups) X(steals) X(sorts) X(ready_comparisons) X(name_comparisons) X(pending_comparisons)
+#define PROFILE_TIMERS(X) X(load) X(sort) X(admit) X(execute) X(run)
 
-                return 1;
+typedef struct {
+#define PROFILE_FIELD(name) uint64_t name;
+    PROFILE_COUNTERS(PROFILE_FIELD)
+    struct {
+        PROFILE_TIMERS(PROFILE_FIELD)
+    } cycles;
+#undef PROFILE_FIELD
+} Profile;
+
+#define PROFILE_COUNT(sim, counter) ((sim)->profile.counter++)
+#define PROFILE_START(timer) uint64_t profile_##timer = profile_cycles()
+#define PROFILE_STOP(sim, timer) ((sim)->profile.cycles.timer += profile_cycles() - profile_##timer)
+#else
+#define PROFILE_COUNT(sim, counter) ((void)0)
+#define PROFILE_START(timer) ((void)0)
+#define PROFILE_STOP(sim, timer) ((void)0)
+#endif
+
+// binary trace writer, events are encoded into a buffer that is written to the file when it is full, see trace.h for the format
+typedef struct {
+    FILE *file;
+    uint8_t buffer[1 << 16];
+    size_t used; // bytes of buffer holding encoded events
+    int last_time; // time of the previous event, events hold time deltas
+    long long event_count; // number of events written
+    long long offset; // file offset of the start of buffer
+    TraceBlock block; // index entry of the events in buffer, its offset is 0 while buffer holds none
+    TraceBlock *blocks; // index entries of the flushed blocks
+    int block_count;
+    int block_capacity;
+    long long *last_arrival; // file offset of the last arrival of each slot, 0 if the slot had none
+    int slot_count; // slots that had an arrival are below it
+    int slot_capacity;
+} TraceWriter;
+
+// block of an arena, its bytes follow the header
+typedef struct ArenaBlock {
+    struct ArenaBlock *next; // next block, blocks are kept in the order they are used
+    size_t size; // usable bytes of the block
+    max_align_t data[]; // storage, aligned for any type
+} ArenaBlock;
+
+// bump allocator for memory that is only needed until the end of a run (sort keys, checkpoints)
+// nothing is freed one by one, a reset gives every block back in O(1) and the next run allocates from the same blocks
+typedef struct {
+    ArenaBlock *first; // first block, NULL until something is allocated
+    ArenaBlock *current; // block allocations are taken from, NULL after a reset
+    size_t used; // bytes used in current block
+} Arena;
 
-            }  else { // equal arrival to ready queue
+// position in an arena, releasing it frees everything allocated after it was taken
+typedef struct {
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
 
-                // if everything is equal check for process names with string comparison
-                return strcmp(a->name, b->name);  
+// simulation context, it holds the whole state of one simulation so independent simulations can run side by side (one per thread)
+// instruction set, programs and configuration are shared by all simulations and they are not changed while simulations run
+typedef struct {
+    ProcessTable processes; // process table, processes are never moved after they are read
+
+    // processes that did not arrive yet are kept in an array of process indices sorted by arrival_time,
+    // so the next arrival event is always at pending_begin and an arrival is removed by moving pending_begin
+    int *pending; // sorted process indices, pending arrivals are from pending_begin to pending_begin + pending_process_count
+    int pending_begin; // position of the next arrival in pending
+    int pending_process_count; // number of processes that did not arrive yet
+
+    // times of terminated processes are summed when they exit, so their slots can be reused
+    int exited_process_count; // number of terminated processes
+    long long total_waiting_time; // total waiting time of terminated processes
+    long long total_turnaround_time; // total turnaround time of terminated processes
+    int makespan; // time the last process terminated
+
+    int *free_slots; // slots of exited processes that can hold new processes, only used if reuse_slots is set
+    int free_slot_count; // number of free slots
+    int reuse_slots; // 1 if slots of exited processes are reused, in streaming mode and for embedded contexts where processes keep coming
+    DefinitionStream *stream; // definition file read while simulating in streaming mode, NULL if it is loaded up front
+    Metrics *metrics; // per-process rows and latency quantiles, NULL if they are not collected
+    TraceWriter *trace; // trace of scheduling events, NULL if it is not written
+    CheckpointLog *checkpoints; // checkpoints taken while simulating for what-if edits, NULL if they are not taken
+    Arena arena; // memory of the current run, it is reset with the simulation and freed with it
+
+    PolicyKind policy; // scheduling policy, kept over reset_simulation
+    uint64_t random_state; // random number generator state of the lottery policy
+
+    Core *cores; // CPU cores, single core by default
+    int core_count; // number of cores
+    DeviceQueue *devices; // request queue of each device
+    int blocked_process_count; // number of processes waiting for or served by a device
+    int *heap_pos; // position of each process in the ready_heap of its core, -1 if process is not in a ready queue
+    int ready_process_count; // number of ready processes in all cores
+    long long events; // iterations of the simulation loop, each is a dispatch, a continuation after an arrival or an idle core waking up
+#ifdef SCHEDULER_PROFILE
+    Profile profile; // kept over reset_simulation, so a batch worker sums the profiles of its runs
+#endif
+} Simulation;
+
+// resizes an array of the process table, exits if memory is not available
+void *grow_array(void *array, int capacity, size_t size) {
+    array = realloc(array, capacity * size);
+    if (array == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
 
+// returns size bytes from the arena, a new block is added if the remaining blocks are too small, exits if memory is not available
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    if (arena->current == NULL || arena->used + size > arena->current->size) {
+        // blocks after the current one are free, a block too small for size is skipped until the next reset
+        ArenaBlock *previous = arena->current;
+        ArenaBlock *block = previous != NULL ? previous->next : arena->first;
+        while (block != NULL && block->size < size) {
+            previous = block;
+            block = block->next;
+        }
+        if (block == NULL) {
+            size_t block_size = previous != NULL ? 2 * previous->size : 1 << 16;
+            if (block_size < size) {
+                block_size = size;
+            }
+            block = malloc(sizeof(ArenaBlock) + block_size);
+            if (block == NULL) {
+                exit(EXIT_FAILURE);
+            }
+            block->next = NULL;
+            block->size = block_size;
+            if (previous != NULL) {
+                previous->next = block;
+            } else {
+                arena->first = block;
             }
-        } 
-    } 
+        }
+        arena->current = block;
+        arena->used = 0;
+    }
+    void *memory = (unsigned char *)arena->current->data + arena->used;
+    arena->used += size;
+    return memory;
 }
 
-// this function checks if any new process entered to system, if so it updated the ready queue
-void update_ready() {
-    // iterate all processes (that did not arrive yet)
-    for(int c = 0; c < process_count; ++c) {
-        // if a process's arrival is happened add it to ready queue and delete it from processes array
-        if (processes[c].arrival_time <= global_time) {
-            ready_processes[ready_process_count++] = processes[c];
-            for (int i = c; i < process_count - 1; ++i) {
-                processes[i] = processes[i + 1];
-            }
-            process_count--; // decrement process count
-            c--; 
-        }  
-    } 
+// returns the current position of the arena
+ArenaMark arena_mark(Arena *arena) {
+    return (ArenaMark){arena->current, arena->used};
 }
 
-// this function handles executions and necessary updates on processes after executions
-void execute_process() {
+// frees everything allocated from the arena after mark was taken, blocks are kept
+void arena_release(Arena *arena, ArenaMark mark) {
+    arena->current = mark.block;
+    arena->used = mark.used;
+}
 
-    // take the scheduled process from the top of the queue
-    Process scheduled = ready_processes[0]; 
-    
-    // if this is the first process in the system or a new process is allowed to enter CPU, make a context switch
-    if (strcmp(lep, "") == 0 || strcmp(lep, scheduled.name) != 0) {
-        global_time += context_switch; // context switch  
-        ongoing_quantum = 0; 
-    } 
+// frees everything allocated from the arena, blocks are kept for the next run
+void arena_reset(Arena *arena) {
+    arena->current = NULL;
+    arena->used = 0;
+}
 
-    // update the last executed process name
-    strcpy(lep, scheduled.name); 
+// frees the blocks of the arena
+void arena_free(Arena *arena) {
+    while (arena->first != NULL) {
+        ArenaBlock *next = arena->first->next;
+        free(arena->first);
+        arena->first = next;
+    }
+    arena->current = NULL;
+    arena->used = 0;
+}
 
-    //printf("SCHEDULED: %s, TIME: %d\n", scheduled.name, global_time); 
+// doubles the capacity of process table and the queues holding process indices
+void grow_processes(Simulation *sim) {
+    int capacity = sim->processes.capacity ? sim->processes.capacity * 2 : 16;
+    sim->processes.name = grow_array(sim->processes.name, capacity, sizeof(*sim->processes.name));
+    sim->processes.priority = grow_array(sim->processes.priority, capacity, sizeof(int));
+    sim->processes.arrival_time = grow_array(sim->processes.arrival_time, capacity, sizeof(int));
+    sim->processes.secondary_arrival = grow_array(sim->processes.secondary_arrival, capacity, sizeof(int));
+    sim->processes.completion_time = grow_array(sim->processes.completion_time, capacity, sizeof(int));
+    sim->processes.type = grow_array(sim->processes.type, capacity, sizeof(*sim->processes.type));
+    sim->processes.defined_type = grow_array(sim->processes.defined_type, capacity, sizeof(*sim->processes.defined_type));
+    sim->processes.PC = grow_array(sim->processes.PC, capacity, sizeof(int));
+    sim->processes.quantum_counter = grow_array(sim->processes.quantum_counter, capacity, sizeof(int));
+    sim->processes.duration = grow_array(sim->processes.duration, capacity, sizeof(int));
+    sim->processes.enter_to_ready = grow_array(sim->processes.enter_to_ready, capacity, sizeof(int));
+    sim->processes.program = grow_array(sim->processes.program, capacity, sizeof(*sim->processes.program));
+    sim->processes.promotion_at = grow_array(sim->processes.promotion_at, capacity, sizeof(int));
+    sim->processes.name_key = grow_array(sim->processes.name_key, capacity, sizeof(uint64_t));
+    sim->processes.first_run = grow_array(sim->processes.first_run, capacity, sizeof(int));
+    sim->processes.switch_count = grow_array(sim->processes.switch_count, capacity, sizeof(int));
+    sim->processes.promotion_time = grow_array(sim->processes.promotion_time, capacity, sizeof(*sim->processes.promotion_time));
+    sim->processes.policy_state = grow_array(sim->processes.policy_state, capacity, sizeof(uint64_t));
+    sim->processes.blocked_at = grow_array(sim->processes.blocked_at, capacity, sizeof(int));
+    sim->processes.io_time = grow_array(sim->processes.io_time, capacity, sizeof(int));
+    sim->pending = grow_array(sim->pending, capacity, sizeof(int));
+    sim->free_slots = grow_array(sim->free_slots, capacity, sizeof(int));
+    for (int c = 0; c < sim->core_count; c++) {
+        // a ready queue may hold every process
+        sim->cores[c].ready_heap = grow_array(sim->cores[c].ready_heap, capacity, sizeof(ReadyEntry));
+    }
+    sim->heap_pos = grow_array(sim->heap_pos, capacity, sizeof(int));
+    sim->processes.capacity = capacity;
+}
 
-    // reset execution time to 0 
-    int execution_time = 0; 
+// prints some fields of a process for debugging purposes
+void printProcess(Simulation *sim, int p) {
+    printf("Name: %s, Pri: %d, Quantum: %d, Arrival: %d, Type: %s PC: %d Duration: %d\n", sim->processes.name[p], sim->processes.priority[p], sim->processes.quantum_counter[p], sim->processes.enter_to_ready[p], config.types[sim->processes.type[p]].name, sim->processes.PC[p], sim->processes.duration[p]); 
+}
 
-    // handle platinum process case
-    if(strcmp(scheduled.type, "PLATINUM") == 0) {
-        
-        // if process name is P1
-        if (strcmp(scheduled.name, "P1") == 0) {
-            
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p1_len) {
-                execution_time += p1[scheduled.PC]; // uddate execution time
-                scheduled.duration += p1[scheduled.PC]; // update duration
-                scheduled.PC++; // increment PC 
-            } 
-
-        // if process name is P2
-        } else if (strcmp(scheduled.name, "P2") == 0) {
-            
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p2_len) {
-                execution_time += p2[scheduled.PC]; // uddate execution time
-                scheduled.duration += p2[scheduled.PC]; // update duration
-                scheduled.PC++;// increment PC 
-            }
+// opens trace file at path and writes its header, returns -1 if it cannot be created
+int open_trace(TraceWriter *trace, const char *path) {
+    memset(trace, 0, sizeof(*trace));
+    trace->file = fopen(path, "wb");
+    if (trace->file == NULL) {
+        return -1;
+    }
+    memcpy(trace->buffer, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    trace->used = TRACE_MAGIC_SIZE;
+    return 0;
+}
 
-        // if process name is P3
-        } else if (strcmp(scheduled.name, "P3") == 0) {
-            
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC< p3_len) {
-                execution_time += p3[scheduled.PC]; // uddate execution time
-                scheduled.duration += p3[scheduled.PC]; // update duration
-                scheduled.PC++; // increment PC 
-            }
+// writes the buffer to the file and adds the index entry of its events
+void flush_trace(TraceWriter *trace) {
+    if (fwrite(trace->buffer, 1, trace->used, trace->file) != trace->used) {
+        fprintf(stderr, "cannot write trace\n");
+        exit(EXIT_FAILURE);
+    }
+    if (trace->block.offset != 0) {
+        if (trace->block_count == trace->block_capacity) {
+            trace->block_capacity = trace->block_capacity ? 2 * trace->block_capacity : 64;
+            trace->blocks = grow_array(trace->blocks, trace->block_capacity, sizeof(TraceBlock));
+        }
+        trace->blocks[trace->block_count++] = trace->block;
+        trace->block.offset = 0;
+    }
+    trace->offset += trace->used;
+    trace->used = 0;
+}
 
-        // if process name is P4
-        } else if (strcmp(scheduled.name, "P4") == 0) {
+// appends value to the footer being written through the buffer
+void put_trace_footer(TraceWriter *trace, uint64_t value) {
+    if (trace->used + 8 > sizeof(trace->buffer)) {
+        flush_trace(trace);
+    }
+    trace_put_u64(trace->buffer + trace->used, value);
+    trace->used += 8;
+}
 
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p4_len) {
-                execution_time += p4[scheduled.PC]; // uddate execution time
-                scheduled.duration += p4[scheduled.PC];  // update duration
-                scheduled.PC++; // increment PC 
-            }
+// writes the remaining events and the footer indexing them, see trace.h
+void close_trace(TraceWriter *trace) {
+    flush_trace(trace);
+    long long footer = trace->offset;
+    for (int i = 0; i < trace->block_count; i++) {
+        put_trace_footer(trace, trace->blocks[i].offset);
+        put_trace_footer(trace, trace->blocks[i].base_time);
+        put_trace_footer(trace, trace->blocks[i].min_time);
+        put_trace_footer(trace, trace->blocks[i].max_time);
+    }
+    for (int p = 0; p < trace->slot_count; p++) {
+        put_trace_footer(trace, trace->last_arrival[p]);
+    }
+    put_trace_footer(trace, footer);
+    put_trace_footer(trace, trace->block_count);
+    put_trace_footer(trace, trace->slot_count);
+    if (trace->used + TRACE_MAGIC_SIZE > sizeof(trace->buffer)) {
+        flush_trace(trace);
+    }
+    memcpy(trace->buffer + trace->used, TRACE_INDEX_MAGIC, TRACE_MAGIC_SIZE);
+    trace->used += TRACE_MAGIC_SIZE;
+    flush_trace(trace);
+    fclose(trace->file);
+    free(trace->blocks);
+    free(trace->last_arrival);
+}
 
-        // if process name is P5
-        } else if (strcmp(scheduled.name, "P5") == 0) {
+// adds an event of process p on the core to the trace, text is the name of an arrival or the new type of a promotion, NULL otherwise
+void trace_event(Simulation *sim, TraceKind kind, int time, Core *core, int p, const char *text) {
+    TraceWriter *trace = sim->trace;
+    if (trace->used + TRACE_MAX_EVENT_SIZE > sizeof(trace->buffer)) {
+        flush_trace(trace);
+    }
+    long long offset = trace->offset + trace->used;
+    if (trace->block.offset == 0) {
+        trace->block = (TraceBlock){offset, trace->last_time, time, time};
+    } else if (time < trace->block.min_time) {
+        trace->block.min_time = time;
+    } else if (time > trace->block.max_time) {
+        trace->block.max_time = time;
+    }
+    uint8_t *out = trace->buffer + trace->used;
+    int n = 0;
+    out[n++] = kind;
+    n += trace_put_varint(out + n, trace_zigzag((int64_t)time - trace->last_time));
+    n += trace_put_varint(out + n, core - sim->cores);
+    n += trace_put_varint(out + n, p);
+    if (kind == TRACE_ARRIVAL) {
+        if (p >= trace->slot_capacity) {
+            int capacity = trace->slot_capacity ? trace->slot_capacity : 1024;
+            while (capacity <= p) {
+                capacity *= 2;
+            }
+            trace->last_arrival = grow_array(trace->last_arrival, capacity, sizeof(long long));
+            memset(trace->last_arrival + trace->slot_capacity, 0, (capacity - trace->slot_capacity) * sizeof(long long));
+            trace->slot_capacity = capacity;
+        }
+        long long previous = trace->last_arrival[p];
+        n += trace_put_varint(out + n, previous != 0 ? offset - previous : 0);
+        trace->last_arrival[p] = offset;
+        if (p >= trace->slot_count) {
+            trace->slot_count = p + 1;
+        }
+    }
+    if (trace_kind_has_text(kind)) {
+        size_t len = strlen(text);
+        out[n++] = len;
+        memcpy(out + n, text, len);
+        n += len;
+    }
+    trace->used += n;
+    trace->last_time = time;
+    trace->event_count++;
+}
 
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p5_len) {
-                execution_time += p5[scheduled.PC]; // uddate execution time
-                scheduled.duration += p5[scheduled.PC]; // update duration
-                scheduled.PC++; // increment PC 
-            }
+// packs first 8 characters of a process name into an integer in big endian order, 
+// so comparing packed names gives the same order as strcmp unless names share their first 8 characters
+uint64_t pack_name(const char *name) {
+    uint64_t key = 0;
+    int i = 0;
+    for (; i < 8 && name[i] != '\0'; i++) {
+        key = (key << 8) | (unsigned char)name[i];
+    }
+    return i == 0 ? 0 : key << (8 * (8 - i));
+}
 
-        // if process name is P6
-        } else if (strcmp(scheduled.name, "P6") == 0) {
+// builds the ordering key of process p, priorities are arranged in order -> (platinum - high priority - early arrival to ready queue)
+// bit 63 is 0 for platinum, bits 31-62 are the inverted priority and bits 0-30 are enter_to_ready, so smaller key is scheduled first
+// (!!! note that not arrival to system, after a process run for a quantum, its enter to ready queue is updated)
+// key must be rebuilt when type, priority or enter_to_ready of the process changes
+uint64_t ready_key(Simulation *sim, int p) {
+    uint64_t not_platinum = sim->processes.type[p] != PLATINUM;
+    uint64_t inverted_priority = 0xFFFFFFFFu - ((uint32_t)sim->processes.priority[p] ^ 0x80000000u);
+    return (not_platinum << 63) | (inverted_priority << 31) | (uint32_t)sim->processes.enter_to_ready[p];
+}
 
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p6_len) {
-                execution_time += p6[scheduled.PC]; // uddate execution time
-                scheduled.duration += p6[scheduled.PC]; // update duration
-                scheduled.PC++; // increment PC 
-            }
+// comparison of two ready entries, if keys are equal process names decide (str comparison)
+int entry_less(Simulation *sim, const ReadyEntry *a, const ReadyEntry *b) {
+    PROFILE_COUNT(sim, ready_comparisons);
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+    if (a->name_key != b->name_key) {
+        return a->name_key < b->name_key;
+    }
+    PROFILE_COUNT(sim, name_comparisons);
+    return strcmp(sim->processes.name[a->process], sim->processes.name[b->process]) < 0;
+}
 
-        // if process name is P7
-        } else if (strcmp(scheduled.name, "P7") == 0) {
+// helpers of ready queue heap of a core, a and b are positions in ready_heap
+int heap_less(Simulation *sim, Core *core, int a, int b) {
+    return entry_less(sim, &core->ready_heap[a], &core->ready_heap[b]);
+}
 
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p7_len) {
-                execution_time += p7[scheduled.PC]; // uddate execution time
-                scheduled.duration += p7[scheduled.PC];// update duration
-                scheduled.PC++;  // increment PC 
-            }
+void heap_swap(Simulation *sim, Core *core, int a, int b) {
+    ReadyEntry tmp = core->ready_heap[a];
+    core->ready_heap[a] = core->ready_heap[b];
+    core->ready_heap[b] = tmp;
+    sim->heap_pos[core->ready_heap[a].process] = a;
+    sim->heap_pos[core->ready_heap[b].process] = b;
+}
 
-        // if process name is P8
-        } else if (strcmp(scheduled.name, "P8") == 0) {
+// move the entry at position i up while it is ordered before its parent
+void heap_sift_up(Simulation *sim, Core *core, int i) {
+    while (i > 0 && heap_less(sim, core, i, (i - 1) / 2)) {
+        heap_swap(sim, core, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
 
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p8_len) {
-                execution_time += p8[scheduled.PC]; // uddate execution time
-                scheduled.duration += p8[scheduled.PC]; // update duration
-                scheduled.PC++; // increment PC 
-            }
+// move the entry at position i down while one of its children is ordered before it
+void heap_sift_down(Simulation *sim, Core *core, int i) {
+    while (1) {
+        int best = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < core->ready_process_count && heap_less(sim, core, left, best)) {
+            best = left;
+        }
+        if (right < core->ready_process_count && heap_less(sim, core, right, best)) {
+            best = right;
+        }
+        if (best == i) {
+            break;
+        }
+        heap_swap(sim, core, i, best);
+        i = best;
+    }
+}
 
-        // if process name is P9
-        } else if (strcmp(scheduled.name, "P9") == 0) {
+// add process with index p to ready queue of a core, key is its ordering key from the scheduling policy
+void ready_queue_push(Simulation *sim, Core *core, int p, uint64_t key) {
+    ReadyEntry *entry = &core->ready_heap[core->ready_process_count];
+    entry->key = key;
+    entry->name_key = sim->processes.name_key[p];
+    entry->process = p;
+    sim->heap_pos[p] = core->ready_process_count;
+    core->ready_process_count++;
+    sim->ready_process_count++;
+    heap_sift_up(sim, core, core->ready_process_count - 1);
+}
 
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p9_len) {
-                execution_time += p9[scheduled.PC]; // uddate execution time
-                scheduled.duration += p9[scheduled.PC]; // update duration
-                scheduled.PC++; // increment PC 
-            }
-        
-        // if process name is P10
-        } else if (strcmp(scheduled.name, "P10") == 0) {
-
-            // since this is a platinum process it will execute in an atomic fashion
-            // execute all instructions
-            while(scheduled.PC < p10_len) {
-                execution_time += p10[scheduled.PC]; // uddate execution time
-                scheduled.duration += p10[scheduled.PC];  // update duration
-                scheduled.PC++; // increment PC 
-            }
+// remove the entry at position i from ready queue of a core
+void ready_queue_remove(Simulation *sim, Core *core, int i) {
+    sim->heap_pos[core->ready_heap[i].process] = -1;
+    core->ready_process_count--;
+    sim->ready_process_count--;
+    if (i < core->ready_process_count) {
+        core->ready_heap[i] = core->ready_heap[core->ready_process_count];
+        sim->heap_pos[core->ready_heap[i].process] = i;
+        heap_sift_up(sim, core, i);
+        heap_sift_down(sim, core, sim->heap_pos[core->ready_heap[i].process]);
+    }
+}
 
-        } 
+// remove the process on top of ready queue of a core
+void ready_queue_pop(Simulation *sim, Core *core) {
+    ready_queue_remove(sim, core, 0);
+}
 
-        global_time += execution_time; // update global time 
-        scheduled.completion_time = global_time; // update completion time of the process
-        exited_processes[exited_process_count++] = scheduled; // add process to exited processes list
+// set the key of process p to its rebuilt key and restore heap order after fields in its key are changed
+void ready_queue_update(Simulation *sim, Core *core, int p, uint64_t key) {
+    core->ready_heap[sim->heap_pos[p]].key = key;
+    heap_sift_up(sim, core, sim->heap_pos[p]);
+    heap_sift_down(sim, core, sim->heap_pos[p]);
+}
 
-        // delete the process from ready queue
-        for (int i = 0; i < ready_process_count - 1; ++i) {
-            ready_processes[i] = ready_processes[i + 1]; 
-        }
-        ready_process_count--; // decrement ready process count
+// returns 1 if process p arrives before process q
+// processes arriving at the same time leave in name order, so they are spread over cores the same way however they were read
+int pending_less(Simulation *sim, int p, int q) {
+    PROFILE_COUNT(sim, pending_comparisons);
+    if (sim->processes.arrival_time[p] != sim->processes.arrival_time[q]) {
+        return sim->processes.arrival_time[p] < sim->processes.arrival_time[q];
+    }
+    if (sim->processes.name_key[p] != sim->processes.name_key[q]) {
+        return sim->processes.name_key[p] < sim->processes.name_key[q];
+    }
+    return strcmp(sim->processes.name[p], sim->processes.name[q]) < 0;
+}
 
-    // handle the processes with type gold
-    } else if (strcmp(scheduled.type, "GOLD") == 0) {
+// returns index of the next arriving process, there must be a pending arrival
+int pending_top(Simulation *sim) {
+    return sim->pending[sim->pending_begin];
+}
 
-        // if process name is P1
-        if (strcmp(scheduled.name, "P1") == 0) {
+// add process with index p to pending arrivals, it is inserted from the back so it is cheap when processes come in arrival order
+void pending_push(Simulation *sim, int p) {
+    // arrived processes before pending_begin are dropped when the array is full, it has room for every process in the table
+    if (sim->pending_begin + sim->pending_process_count == sim->processes.capacity) {
+        memmove(sim->pending, sim->pending + sim->pending_begin, sim->pending_process_count * sizeof(int));
+        sim->pending_begin = 0;
+    }
+    int i = sim->pending_begin + sim->pending_process_count++;
+    while (i > sim->pending_begin && pending_less(sim, p, sim->pending[i - 1])) {
+        sim->pending[i] = sim->pending[i - 1];
+        i--;
+    }
+    sim->pending[i] = p;
+}
 
-            execution_time += p1[scheduled.PC]; // uddate execution time
-            scheduled.duration += p1[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time; // update current quantum time
-            global_time += execution_time;  // update global time 
+// remove the earliest arrival from pending arrivals
+void pending_pop(Simulation *sim) {
+    sim->pending_begin++;
+    sim->pending_process_count--;
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
-            
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
-
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time; // update its secondary arrival
-                }
+// sort key of a pending process, see pending_less
+typedef struct {
+    int arrival_time;
+    uint64_t name_key;
+    const char *name;
+    int process;
+} PendingKey;
+
+// comparison function used in qsort function to order pending arrivals
+int cmp_pending(const void *left, const void *right) {
+    const PendingKey *a = left;
+    const PendingKey *b = right;
+    if (a->arrival_time != b->arrival_time) {
+        return a->arrival_time < b->arrival_time ? -1 : 1;
+    }
+    if (a->name_key != b->name_key) {
+        return a->name_key < b->name_key ? -1 : 1;
+    }
+    return strcmp(a->name, b->name);
+}
 
-            // it was a silver process and promoted to gold
-            } else { 
+// sorts pending arrivals after processes are appended to pending out of order, nothing is done if they are already sorted
+void pending_sort(Simulation *sim) {
+    int *pending = sim->pending + sim->pending_begin;
+    int count = sim->pending_process_count;
+    int sorted = 1;
+    for (int i = 1; i < count && sorted; i++) {
+        sorted = !pending_less(sim, pending[i], pending[i - 1]);
+    }
+    if (sorted) {
+        return;
+    }
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time; // update its secondary arrival
-                }
-            }
+    ArenaMark mark = arena_mark(&sim->arena);
+    PendingKey *keys = arena_alloc(&sim->arena, count * sizeof(PendingKey));
+    for (int i = 0; i < count; i++) {
+        int p = pending[i];
+        keys[i] = (PendingKey){sim->processes.arrival_time[p], sim->processes.name_key[p], sim->processes.name[p], p};
+    }
+    PROFILE_COUNT(sim, sorts);
+    PROFILE_START(sort);
+    qsort(keys, count, sizeof(PendingKey), cmp_pending);
+    PROFILE_STOP(sim, sort);
+    for (int i = 0; i < count; i++) {
+        pending[i] = keys[i].process;
+    }
+    arena_release(&sim->arena, mark);
+}
 
-            // if exit instruction is executed
-            if(p1[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled; // add the process to exited process list
+// returns the core with the fewest ready processes, arriving processes are added to its ready queue
+Core *least_loaded_core(Simulation *sim) {
+    Core *best = &sim->cores[0];
+    for (int c = 1; c < sim->core_count; c++) {
+        if (sim->cores[c].ready_process_count < best->ready_process_count) {
+            best = &sim->cores[c];
+        }
+    }
+    return best;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--; // decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// idle core takes the best ready process of the core with the most waiting processes, the process that core last executed is not taken
+// returns 1 if a process is taken
+int steal_process(Simulation *sim, Core *core) {
+    Core *victim = NULL;
+    int victim_waiting = 0;
+    for (int c = 0; c < sim->core_count; c++) {
+        Core *other = &sim->cores[c];
+        // processes waiting in ready queue of the other core, other than the one it last executed
+        int waiting = other->ready_process_count;
+        if (other->lep != -1 && sim->heap_pos[other->lep] != -1) {
+            waiting--;
+        }
+        if (other != core && waiting > victim_waiting) {
+            victim = other;
+            victim_waiting = waiting;
+        }
+    }
+    if (victim == NULL) {
+        return 0;
+    }
 
-        // if process name is P2
-        } else if (strcmp(scheduled.name, "P2") == 0) {
+    // best entry that is not the last executed process is either the top or one of its children
+    int pos = 0;
+    if (victim->ready_heap[0].process == victim->lep) {
+        pos = 1;
+        if (victim->ready_process_count > 2 && heap_less(sim, victim, 2, 1)) {
+            pos = 2;
+        }
+    }
+    int p = victim->ready_heap[pos].process;
+    uint64_t key = victim->ready_heap[pos].key;
+    ready_queue_remove(sim, victim, pos);
+    ready_queue_push(sim, core, p, key);
+    core->steals++;
+    PROFILE_COUNT(sim, steals);
+
+    // process cannot run before it entered to ready queue of the other core
+    if (core->time < sim->processes.enter_to_ready[p]) {
+        core->time = sim->processes.enter_to_ready[p];
+    }
+    return 1;
+}
 
-            execution_time += p2[scheduled.PC]; // uddate execution time
-            scheduled.duration += p2[scheduled.PC];// update duration
-            ongoing_quantum += execution_time; // update current quantum time
-            global_time += execution_time;  // update global time 
+// returns the core to simulate next, the one with the smallest time, a core with ready processes is chosen first on equal times
+Core *next_core(Simulation *sim) {
+    Core *best = &sim->cores[0];
+    for (int c = 1; c < sim->core_count; c++) {
+        Core *core = &sim->cores[c];
+        if (core->time < best->time || (core->time == best->time && core->ready_process_count > 0 && best->ready_process_count == 0)) {
+            best = core;
+        }
+    }
+    return best;
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++;// increment PC
+// returns the time the state of a device changes next, a request completes or a waiting request can be started, INT_MAX if all devices are idle
+int next_device_event(Simulation *sim) {
+    int next = INT_MAX;
+    for (int d = 0; d < device_count; d++) {
+        DeviceQueue *device = &sim->devices[d];
+        int time = INT_MAX;
+        if (device->serving != -1) {
+            time = device->free_at;
+        } else if (device->count > 0) {
+            int requested = sim->processes.blocked_at[device->queue[device->begin]];
+            time = requested > device->free_at ? requested : device->free_at;
+        }
+        if (time < next) {
+            next = time;
+        }
+    }
+    return next;
+}
 
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
+// returns the next time an idle core should check for work again, the next arrival, the next device event or the time of a busy core as it may have processes to steal then
+// INT_MAX if no process will arrive or wake up and no other core has ready processes, so the core is finished
+int next_wakeup(Simulation *sim, Core *core) {
+    int wakeup = sim->pending_process_count > 0 ? sim->processes.arrival_time[pending_top(sim)] : INT_MAX;
+    if (device_count > 0) {
+        int next_io = next_device_event(sim);
+        if (next_io < wakeup) {
+            wakeup = next_io;
+        }
+    }
+    for (int c = 0; c < sim->core_count; c++) {
+        Core *other = &sim->cores[c];
+        if (other != core && other->ready_process_count > 0 && other->time > core->time && other->time < wakeup) {
+            wakeup = other->time;
+        }
+    }
+    return wakeup;
+}
 
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time; // update its secondary arrival
-                }
+// sets configuration key to the decimal integer value, returns -1 if the key is unknown and -2 if the value is invalid
+int set_config(const char *key, const char *value) {
+    for (size_t k = 0; k < sizeof(config_keys) / sizeof(config_keys[0]); k++) {
+        if (strcmp(config_keys[k].key, key) == 0) {
+            char *end;
+            long number = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || number < config_keys[k].minimum || number > INT_MAX) {
+                return -2;
+            }
+            *config_keys[k].value = (int)number;
+            return 0;
+        }
+    }
+    return -1;
+}
 
-            // it was a silver process and promoted to gold
-            } else {
+// prints the error status of set_config, where is the file and line or the option the value came from
+void config_error(const char *where, int status, const char *key, const char *value) {
+    if (status == -1) {
+        fprintf(stderr, "%s: unknown configuration key '%s'\n", where, key);
+    } else {
+        fprintf(stderr, "%s: invalid value '%s' for %s\n", where, value, key);
+    }
+}
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time; // update its secondary arrival
-                }
-            }
+// reads configuration values from the file at path, each line is "key = value" or "key value" and # starts a comment
+// returns 0 on success, -1 if the file cannot be opened or a line is invalid, the error is already printed then
+int load_config(const char *path) {
+    FILE *filepointer = fopen(path, "r");
+    if (filepointer == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char line[256];
+    int line_number = 0;
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), filepointer) != NULL) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char key[64], value[32];
+        int end = 0;
+        int fields = sscanf(line, " %63[^= \t\r\n]%*[= \t]%31s %n", key, value, &end);
+        if (fields == EOF) { // blank line
+            continue;
+        }
+        char where[4096];
+        snprintf(where, sizeof(where), "%s:%d", path, line_number);
+        if (fields != 2 || line[end] != '\0') {
+            fprintf(stderr, "%s: expected key = value\n", where);
+            status = -1;
+        } else if ((status = set_config(key, value)) != 0) {
+            config_error(where, status, key, value);
+            status = -1;
+        }
+    }
+    fclose(filepointer);
+    return status;
+}
 
-            // if exit instruction is executed
-            if(p2[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// returns the index of the device with given name, a device that is not listed in devices.txt is added as a fifo device
+int find_device(const char *name) {
+    for (int d = 0; d < device_count; d++) {
+        if (strcmp(devices[d].name, name) == 0) {
+            return d;
+        }
+    }
+    devices = realloc(devices, (device_count + 1) * sizeof(Device));
+    if (devices == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    snprintf(devices[device_count].name, sizeof(devices[device_count].name), "%s", name);
+    devices[device_count].elevator = 0;
+    devices[device_count].seek_time = 0;
+    return device_count++;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// reads devices from devices.txt if it exists, each line is a device name, fifo or elevator and an optional seek time per track
+void load_devices() {
+    FILE *filepointer = fopen("devices.txt", "r");
+    if (filepointer == NULL) {
+        return; // instructions use the CPU only or their devices are fifo
+    }
 
-        // if process name is P3
-        } else if (strcmp(scheduled.name, "P3") == 0) {
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), filepointer) != NULL) {
+        line_number++;
+        char name[32], order[16];
+        int seek_time = 0;
+        int fields = sscanf(line, "%31s %15s %d", name, order, &seek_time);
+        if (fields == EOF) { // blank line
+            continue;
+        }
+        if (fields < 2 || (strcmp(order, "fifo") != 0 && strcmp(order, "elevator") != 0) || seek_time < 0) {
+            fprintf(stderr, "devices.txt:%d: expected name fifo|elevator [seek_time]\n", line_number);
+            exit(EXIT_FAILURE);
+        }
+        int d = find_device(name);
+        devices[d].elevator = strcmp(order, "elevator") == 0;
+        devices[d].seek_time = seek_time;
+    }
 
-            execution_time += p3[scheduled.PC]; // uddate execution time
-            scheduled.duration += p3[scheduled.PC];// update duration
-            ongoing_quantum += execution_time; // update current quantum time
-            global_time += execution_time;  // update global time 
+    fclose(filepointer);
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
-            
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
-
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
+// appends instruction to the instruction set
+void add_instruction(const Instruction *instruction) {
+    // grow instructions array if it is full
+    if (instruction_count == instruction_capacity) {
+        instruction_capacity = instruction_capacity ? instruction_capacity * 2 : 32;
+        instructions = realloc(instructions, instruction_capacity * sizeof(Instruction));
+        if (instructions == NULL) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    instructions[instruction_count++] = *instruction;
+}
 
-            // it was a silver process and promoted to gold
-            } else {
-                if(scheduled.quantum_counter >= 8) { 
+// reads instruction set from instructions.txt, each line is an instruction name and its burst time
+// an I/O instruction is followed by its device name and an optional track, like "read 40 disk 120"
+void load_instructions() {
+    load_devices();
+    FILE *filepointer = fopen("instructions.txt", "r");
+    if (filepointer == NULL) {
+        fprintf(stderr, "cannot open instructions.txt\n");
+        exit(EXIT_FAILURE); 
+    }
 
-                    // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            }
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), filepointer) != NULL) {
+        line_number++;
+        Instruction instruction;
+        char device[32];
+        instruction.track = 0;
+        int fields = sscanf(line, "%31s %d %31s %d", instruction.name, &instruction.burst, device, &instruction.track);
+        if (fields == EOF) { // blank line
+            continue;
+        }
+        if (fields < 2 || instruction.burst < 0 || instruction.track < 0) {
+            fprintf(stderr, "instructions.txt:%d: expected name burst [device [track]]\n", line_number);
+            exit(EXIT_FAILURE);
+        }
+        instruction.device = fields >= 3 ? find_device(device) : -1;
+        add_instruction(&instruction);
+    }
 
-            // if exit instruction is executed
-            if(p3[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+    fclose(filepointer);
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// returns index of the instruction with given name in the instruction set, -1 if it is unknown
+int lookup_instruction(const char *name) {
+    for (int i = 0; i < instruction_count; i++) {
+        if (strcmp(instructions[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
 
-        // if process name is P4
-        } else if (strcmp(scheduled.name, "P4") == 0) {
+// allocates a program of length instructions from arena, or with malloc if arena is NULL, the arrays are left to the caller
+Program *alloc_program(const char *name, int length, Arena *arena) {
+    // program block holds length burst times, length + 1 prefix sums, length instruction indices and length + 1 next_io entries
+    size_t size = sizeof(Program) + (4 * (size_t)length + 2) * sizeof(int);
+    Program *program = arena != NULL ? arena_alloc(arena, size) : malloc(size);
+    if (program == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    snprintf(program->name, sizeof(program->name), "%s", name);
+    program->length = length;
+    program->bursts = program->data;
+    program->prefix = program->bursts + length;
+    program->instruction = program->prefix + length + 1;
+    program->next_io = program->instruction + length;
+    return program;
+}
 
-            execution_time += p4[scheduled.PC]; // uddate execution time
-            scheduled.duration += p4[scheduled.PC];// update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// builds prefix sums of the burst times of a program, I/O instructions do not use the CPU so they add nothing
+void build_prefix(Program *program) {
+    program->prefix[0] = 0;
+    for (int i = 0; i < program->length; i++) {
+        program->prefix[i + 1] = program->prefix[i] + (program->next_io[i] == i ? 0 : program->bursts[i]);
+    }
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
-            
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
-
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            
-            // it was a silver process and promoted to gold
-            } else {
+// returns NULL if the length instructions at indices make a valid program, otherwise the reason it is not valid
+const char *program_error(const int *indices, int length) {
+    if (length == 0) {
+        return "has no instructions";
+    }
+    if (instructions[indices[length - 1]].device != -1) { // a process terminates on the CPU
+        return "ends with an I/O instruction";
+    }
+    return NULL;
+}
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            }
+// builds the program with given name from the instruction set indices of its length instructions, they must pass program_error
+// burst times of its instructions are stored after the structure
+Program *build_program(const char *name, const int *indices, int length) {
+    Program *program = alloc_program(name, length, NULL);
+    memcpy(program->instruction, indices, length * sizeof(int));
+    program->next_io[length] = length;
+    for (int i = length - 1; i >= 0; i--) {
+        program->next_io[i] = instructions[program->instruction[i]].device != -1 ? i : program->next_io[i + 1];
+    }
+    for (int i = 0; i < length; i++) {
+        program->bursts[i] = instructions[program->instruction[i]].burst;
+    }
+    build_prefix(program);
+    return program;
+}
 
-            // if exit instruction is executed
-            if(p4[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// reads the program with given name from <name>.txt
+// returns NULL if the file cannot be opened or the program is not valid, the reason is written to error then
+Program *read_program(const char *name, char *error, size_t error_size) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s.txt", name);
+    FILE *filepointer = fopen(path, "r");
+    if (filepointer == NULL) {
+        snprintf(error, error_size, "cannot open %s", path);
+        return NULL;
+    }
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
+    // read the instructions of the program
+    int *indices = NULL;
+    int length = 0;
+    int capacity = 0;
+    char instruction[32];
+    int unknown = 0; // 1 if reading stopped at an unknown instruction
+    while (!unknown && fscanf(filepointer, "%31s", instruction) == 1) {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            indices = realloc(indices, capacity * sizeof(int));
+            if (indices == NULL) {
+                exit(EXIT_FAILURE);
             }
+        }
+        indices[length] = lookup_instruction(instruction);
+        if (indices[length] == -1) {
+            snprintf(error, error_size, "unknown instruction %s", instruction);
+            unknown = 1;
+        } else {
+            length++;
+        }
+    }
+    fclose(filepointer);
+
+    Program *program = NULL;
+    const char *reason = unknown ? NULL : program_error(indices, length);
+    if (reason != NULL) {
+        snprintf(error, error_size, "program %s %s", name, reason);
+    } else if (!unknown) {
+        program = build_program(name, indices, length);
+    }
+    free(indices);
+    return program;
+}
 
-        // if process name is P5
-        } else if (strcmp(scheduled.name, "P5") == 0) {
+// returns the loaded program with given name, NULL if it is not loaded, program_lock must be held
+const Program *find_program(const char *name) {
+    for (int i = 0; i < program_count; i++) {
+        if (strcmp(programs[i]->name, name) == 0) {
+            return programs[i];
+        }
+    }
+    return NULL;
+}
 
-            execution_time += p5[scheduled.PC]; // uddate execution time
-            scheduled.duration += p5[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// adds program to the loaded programs, program_lock must be held
+void register_program(Program *program) {
+    // grow programs array if it is full
+    if (program_count == program_capacity) {
+        program_capacity = program_capacity ? program_capacity * 2 : 16;
+        programs = realloc(programs, program_capacity * sizeof(Program *));
+        if (programs == NULL) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    programs[program_count++] = program;
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
-            
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
-
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            
-            // it was a silver process and promoted to gold
-            } else {
+// returns the program with given name, it is read when it is used for the first time
+// returns NULL if it cannot be read, the reason is written to error then
+const Program *try_load_program(const char *name, char *error, size_t error_size) {
+    pthread_mutex_lock(&program_lock);
+
+    // program may already be loaded for another process
+    const Program *program = find_program(name);
+    if (program == NULL) {
+        Program *read = read_program(name, error, error_size);
+        if (read != NULL) {
+            register_program(read);
+        }
+        program = read;
+    }
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            }
+    pthread_mutex_unlock(&program_lock);
+    return program;
+}
 
-            // if exit instruction is executed
-            if(p5[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// returns the process type whose name is the len characters at name, -1 if it is unknown
+int parse_type(const char *name, int len) {
+    for (int t = 0; t < TYPE_COUNT; t++) {
+        if ((int)strlen(config.types[t].name) == len && memcmp(config.types[t].name, name, len) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// promotes process p to the next type if it used its quanta in the current type (by default silver -> gold after 3, gold -> platinum after 5)
+// quanta are counted since arrival, so a gold process that was silver earlier is promoted after 3 + 5 = 8 quanta
+// it is called on the core that ran p, at the time of the core
+void check_promotion(Simulation *sim, Core *core, int p) {
+    TypePolicy *policy = &config.types[sim->processes.type[p]];
+    if (policy->promotion > 0 && sim->processes.quantum_counter[p] >= sim->processes.promotion_at[p]) {
+        sim->processes.type[p] = policy->promoted_to; 
+        sim->processes.promotion_at[p] += config.types[policy->promoted_to].promotion;
+        sim->processes.secondary_arrival[p] = core->time; // update its secondary arrival
+        sim->processes.promotion_time[p][policy->promoted_to] = core->time;
+        PROFILE_COUNT(sim, promotions);
+        if (sim->trace != NULL) {
+            trace_event(sim, TRACE_PROMOTION, core->time, core, p, config.types[policy->promoted_to].name);
+        }
+    }
+}
 
-        // if process name is P6
-        } else if (strcmp(scheduled.name, "P6") == 0) {
+// total burst time of the instructions of a program from pc (included) to k (excluded)
+int burst_between(const Program *program, int pc, int k) {
+    return program->prefix[k] - program->prefix[pc];
+}
 
-            execution_time += p6[scheduled.PC]; // uddate execution time
-            scheduled.duration += p6[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// remaining burst time of a program from pc to its end, a platinum process scheduled now completes after this time
+int remaining_burst(const Program *program, int pc) {
+    return burst_between(program, pc, program->length);
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+// returns the smallest k > pc such that instructions from pc to k take at least budget time, or program length if it ends earlier
+// it finds the instruction that completes the current quantum or that is running when the next arrival happens
+int advance_pc(const Program *program, int pc, int budget) {
+    const int *prefix = program->prefix;
+    int target = prefix[pc] + budget;
+    int low = pc + 1;
+    int high = program->length;
+    // binary search on prefix sums
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (prefix[mid] >= target) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
 
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
+#define POLICY_INLINE static inline __attribute__((always_inline))
 
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            
-            // it was a silver process and promoted to gold
-            } else {
+#define MAX_SHARE 100 // largest share, priorities are clamped to [1, MAX_SHARE] for CFS weights and lottery tickets
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            }
+// returns the policy with given name, -1 if it is unknown
+int parse_policy(const char *name) {
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        if (strcmp(policy_names[k], name) == 0) {
+            return k;
+        }
+    }
+    return -1;
+}
 
-            // if exit instruction is executed
-            if(p6[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// returns the next number of a splitmix64 generator, its state is a single word so every simulation or replication has its own
+uint64_t random_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// returns a uniform random number in (0, 1] from the generator with given state
+double random_uniform(uint64_t *state) {
+    return ((random_next(state) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
 
-        // if process name is P7
-        } else if (strcmp(scheduled.name, "P7") == 0) {
+// returns a uniform random number in (0, 1] from the generator of the simulation
+double random_unit(Simulation *sim) {
+    return random_uniform(&sim->random_state);
+}
 
-            execution_time += p7[scheduled.PC]; // uddate execution time
-            scheduled.duration += p7[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// share of process p for CFS and lottery
+POLICY_INLINE int policy_share(Simulation *sim, int p) {
+    int priority = sim->processes.priority[p];
+    return priority < 1 ? 1 : priority > MAX_SHARE ? MAX_SHARE : priority;
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+// lottery pass increment of process p, an exponential draw with rate equal to its tickets
+// the ready process with the smallest pass wins, as exponential draws are memoryless every slice is a fair lottery
+POLICY_INLINE uint64_t lottery_draw(Simulation *sim, int p) {
+    return (uint64_t)(-log(random_unit(sim)) / policy_share(sim, p) * (1 << 24));
+}
 
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
+// ordering key of process p in ready queues, smaller key is scheduled first and process names break ties
+POLICY_INLINE uint64_t policy_key(const PolicyKind policy, Simulation *sim, int p) {
+    const Program *program = sim->processes.program[p];
+    uint64_t arrival = (uint32_t)sim->processes.arrival_time[p];
+    switch (policy) {
+    case POLICY_PRIORITY:
+        return ready_key(sim, p);
+    case POLICY_FCFS:
+        return arrival;
+    case POLICY_SJF:
+        return ((uint64_t)program->prefix[program->length] << 31) | arrival;
+    case POLICY_SRTF:
+        return ((uint64_t)remaining_burst(program, sim->processes.PC[p]) << 31) | arrival;
+    case POLICY_MLFQ:
+        return (sim->processes.policy_state[p] << 31) | (uint32_t)sim->processes.enter_to_ready[p];
+    case POLICY_CFS:
+    case POLICY_LOTTERY:
+    default:
+        return sim->processes.policy_state[p];
+    }
+}
 
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            
-            // it was a silver process and promoted to gold
-            } else {
+// time slice of process p, 0 if it runs to completion once it is scheduled
+// a process that is not done when its slice ends goes back to the ready queue, an arrival can preempt it before that
+POLICY_INLINE int policy_quantum(const PolicyKind policy, Simulation *sim, int p) {
+    switch (policy) {
+    case POLICY_PRIORITY:
+        return config.types[sim->processes.type[p]].quantum;
+    case POLICY_FCFS:
+    case POLICY_SJF:
+        return 0;
+    case POLICY_SRTF:
+        return INT_MAX; // only arrivals preempt
+    case POLICY_MLFQ:
+        return config.mlfq_quanta[sim->processes.policy_state[p]];
+    case POLICY_CFS:
+    case POLICY_LOTTERY:
+    default:
+        return config.slice;
+    }
+}
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
+// process p arrives to the ready queue of the core
+POLICY_INLINE void policy_on_arrival(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    switch (policy) {
+    case POLICY_MLFQ:
+        sim->processes.policy_state[p] = 0;
+        break;
+    case POLICY_CFS:
+        sim->processes.policy_state[p] = core->virtual_time; // starts with the smallest virtual runtime of the core
+        break;
+    case POLICY_LOTTERY:
+        sim->processes.policy_state[p] = core->virtual_time + lottery_draw(sim, p);
+        break;
+    default:
+        break;
+    }
+}
+
+// process p on top of the ready queue is selected to run on the core
+POLICY_INLINE void policy_on_select(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    switch (policy) {
+    case POLICY_CFS:
+        if (sim->processes.policy_state[p] > core->virtual_time) {
+            core->virtual_time = sim->processes.policy_state[p]; // minimum virtual runtime only grows
+        }
+        break;
+    case POLICY_LOTTERY:
+        core->virtual_time = sim->processes.policy_state[p]; // pass of the winner
+        break;
+    default:
+        break;
+    }
+}
+
+// process p executed instructions for execution_time
+POLICY_INLINE void policy_on_run(const PolicyKind policy, Simulation *sim, int p, int execution_time) {
+    if (policy == POLICY_CFS) {
+        sim->processes.policy_state[p] += (uint64_t)execution_time * MAX_SHARE / policy_share(sim, p);
+    }
+}
+
+// process p used up its quantum on the core and goes back to the ready queue
+POLICY_INLINE void policy_on_quantum_expiry(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    sim->processes.quantum_counter[p]++;  // increment quantum counter 
+    sim->processes.enter_to_ready[p] = core->time; // update enter_to_ready for round robin
+    switch (policy) {
+    case POLICY_PRIORITY:
+        // promote the process if it reached the quantum count of its type
+        check_promotion(sim, core, p);
+        break;
+    case POLICY_MLFQ:
+        if (sim->processes.policy_state[p] < MLFQ_LEVELS - 1) {
+            sim->processes.policy_state[p]++;
+        }
+        break;
+    case POLICY_LOTTERY:
+        sim->processes.policy_state[p] += lottery_draw(sim, p);
+        break;
+    default:
+        break;
+    }
+}
+
+// process p was preempted on the core by an arrival before its quantum ended, it stays in the ready queue
+POLICY_INLINE void policy_on_preempt(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    sim->processes.enter_to_ready[p] = core->time; // set its enter to ready field to current time
+    sim->processes.quantum_counter[p]++; // increment its quantum counter
+    if (policy == POLICY_PRIORITY) {
+        // promote the process if it reached the quantum count of its type
+        check_promotion(sim, core, p);
+    }
+}
+
+// process p left the CPU of the core for an I/O request before its quantum ended, it is not in a ready queue until the request completes
+// as with a preemption the CPU burst counts as a quantum, an MLFQ process keeps its level since it did not use up its quantum
+POLICY_INLINE void policy_on_block(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    sim->processes.quantum_counter[p]++;
+    if (policy == POLICY_PRIORITY) {
+        // promote the process if it reached the quantum count of its type
+        check_promotion(sim, core, p);
+    }
+}
+
+// I/O request of process p completed and it enters the ready queue of the core again
+POLICY_INLINE void policy_on_wakeup(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    switch (policy) {
+    case POLICY_CFS:
+        if (sim->processes.policy_state[p] < core->virtual_time) {
+            sim->processes.policy_state[p] = core->virtual_time; // sleeping does not earn CPU time over the others
+        }
+        break;
+    case POLICY_LOTTERY:
+        sim->processes.policy_state[p] = core->virtual_time + lottery_draw(sim, p);
+        break;
+    default:
+        break;
+    }
+}
+
+// log of the bucket growth factor of quantile sketches
+double quantile_log_gamma(void) {
+    return log((1 + QUANTILE_ACCURACY) / (1 - QUANTILE_ACCURACY));
+}
+
+// adds observation x to the sketch
+void quantile_add(QuantileSketch *q, double x) {
+    q->count++;
+    if (x <= 0) {
+        q->zero++;
+        return;
+    }
+    int i = (int)ceil(log(x) / quantile_log_gamma());
+    q->bucket[i < 0 ? 0 : i < QUANTILE_BUCKETS ? i : QUANTILE_BUCKETS - 1]++;
+}
+
+// returns the estimate of quantile p (0.5 for the median) as the nearest rank, 0 if there are no observations
+double quantile_value(const QuantileSketch *q, double p) {
+    long long rank = (long long)ceil(p * q->count);
+    long long seen = q->zero;
+    if (q->count == 0 || seen >= rank) {
+        return 0;
+    }
+    int i = 0;
+    while (i < QUANTILE_BUCKETS - 1 && (seen += q->bucket[i]) < rank) {
+        i++;
+    }
+    // midpoint of (gamma^(i-1), gamma^i] in relative terms
+    double gamma = exp(quantile_log_gamma());
+    return 2 * pow(gamma, i) / (gamma + 1);
+}
+
+// starts metrics collection, rows are written to csv if it is not NULL
+void init_metrics(Metrics *metrics, FILE *csv) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->csv = csv;
+    if (csv != NULL) {
+        fprintf(csv, "name,type,priority,arrival,first_run,completion,response,waiting,turnaround,context_switches,quantum_counter,io_time");
+        for (int t = 0; t < TYPE_COUNT; t++) {
+            if (config.types[t].promotion > 0) {
+                fprintf(csv, ",promoted_to_%s", config.types[config.types[t].promoted_to].name);
             }
-            
-            // if exit instruction is executed
-            if(p7[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
-
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
+        }
+        fprintf(csv, "\n");
+    }
+}
+
+// adds terminated process p to the quantiles and writes its row
+void record_metrics(Simulation *sim, int p, int turnaround_time, int waiting_time) {
+    Metrics *metrics = sim->metrics;
+    int response_time = sim->processes.first_run[p] - sim->processes.arrival_time[p];
+    quantile_add(&metrics->waiting, waiting_time);
+    quantile_add(&metrics->turnaround, turnaround_time);
+    quantile_add(&metrics->response, response_time);
+    if (metrics->csv != NULL) {
+        fprintf(metrics->csv, "%s,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d", sim->processes.name[p], config.types[sim->processes.type[p]].name,
+                sim->processes.priority[p], sim->processes.arrival_time[p], sim->processes.first_run[p], sim->processes.completion_time[p],
+                response_time, waiting_time, turnaround_time, sim->processes.switch_count[p], sim->processes.quantum_counter[p],
+                sim->processes.io_time[p]);
+        for (int t = 0; t < TYPE_COUNT; t++) {
+            if (config.types[t].promotion > 0) {
+                fprintf(metrics->csv, ",%d", sim->processes.promotion_time[p][config.types[t].promoted_to]);
             }
+        }
+        fprintf(metrics->csv, "\n");
+    }
+}
 
-        // if process name is P8
-        } else if (strcmp(scheduled.name, "P8") == 0) {
+// process p on top of the ready queue of the core executed its exit instruction, it is deleted from the ready queue
+// its times are added to the totals right away, so in streaming mode or in an embedded context its slot can be given to a later arrival
+void exit_process(Simulation *sim, Core *core, int p) {
+    sim->processes.completion_time[p] = core->time; // set completion time of the process
+
+    // Turnaround time = Time of Completion - Time Of Arrival, Waiting Time = Turnaround Time - Burst Time - Time Blocked on I/O
+    int turnaround_time = core->time - sim->processes.arrival_time[p];
+    int waiting_time = turnaround_time - sim->processes.duration[p] - sim->processes.io_time[p];
+    sim->total_turnaround_time += turnaround_time;
+    sim->total_waiting_time += waiting_time;
+    if (sim->metrics != NULL) {
+        record_metrics(sim, p, turnaround_time, waiting_time);
+    }
+    if (core->time > sim->makespan) {
+        sim->makespan = core->time;
+    }
+    sim->exited_process_count++;
 
-            execution_time += p8[scheduled.PC]; // uddate execution time
-            scheduled.duration += p8[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+    ready_queue_pop(sim, core);
+    PROFILE_COUNT(sim, exits);
+    if (sim->trace != NULL) {
+        trace_event(sim, TRACE_EXIT, core->time, core, p, NULL);
+    }
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
+    // the next process on the core needs a context switch anyway, forgetting p keeps a reused slot from being taken for it
+    core->lep = -1;
+    if (sim->reuse_slots) {
+        sim->free_slots[sim->free_slot_count++] = p;
+    }
+}
+
+// adds blocked process p to the requests of the device, requests mostly come in time order so it is inserted from the back
+void device_push(Simulation *sim, DeviceQueue *device, int p) {
+    if (device->begin + device->count == device->capacity) {
+        if (device->begin > device->count) { // reuse the space of served requests
+            memmove(device->queue, device->queue + device->begin, device->count * sizeof(int));
+            device->begin = 0;
+        } else {
+            device->capacity = device->capacity ? device->capacity * 2 : 16;
+            device->queue = grow_array(device->queue, device->capacity, sizeof(int));
+        }
+    }
+    int *queue = device->queue;
+    int i = device->begin + device->count++;
+    while (i > device->begin && sim->processes.blocked_at[queue[i - 1]] > sim->processes.blocked_at[p]) {
+        queue[i] = queue[i - 1];
+        i--;
+    }
+    queue[i] = p;
+}
+
+// returns the position in queue of the request the device serves next at time start, the oldest one for a fifo device
+// an elevator device takes the nearest track in its direction among the requests made until start and turns when there is none
+int device_pick(Simulation *sim, const Device *definition, DeviceQueue *device, int start) {
+    if (!definition->elevator) {
+        return device->begin;
+    }
+    for (int turn = 0; turn < 2; turn++) {
+        int best = -1, best_distance = INT_MAX;
+        for (int i = device->begin; i < device->begin + device->count; i++) {
+            int p = device->queue[i];
+            if (sim->processes.blocked_at[p] > start) {
+                break; // later requests are not made yet
+            }
+            const Program *program = sim->processes.program[p];
+            int distance = (instructions[program->instruction[sim->processes.PC[p] - 1]].track - device->head) * device->direction;
+            if (distance >= 0 && distance < best_distance) {
+                best = i;
+                best_distance = distance;
             }
-            scheduled.PC++;// increment PC
+        }
+        if (best != -1) {
+            return best;
+        }
+        device->direction = -device->direction;
+    }
+    return device->begin; // not reached, the oldest request is always on one side of the head
+}
 
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
+// process p on top of the ready queue of the core reached an I/O instruction, it leaves the ready queue and waits for the device
+// the instruction is done when its request completes, so PC moves past it now
+POLICY_INLINE void block_process(const PolicyKind policy, Simulation *sim, Core *core, int p) {
+    const Program *program = sim->processes.program[p];
+    const Instruction *io = &instructions[program->instruction[sim->processes.PC[p]]];
+    sim->processes.PC[p]++;
+    sim->processes.blocked_at[p] = core->time;
+    ready_queue_pop(sim, core);
+    device_push(sim, &sim->devices[io->device], p);
+    sim->blocked_process_count++;
+    policy_on_block(policy, sim, core, p);
+    PROFILE_COUNT(sim, blocks);
+    if (sim->trace != NULL) {
+        trace_event(sim, TRACE_BLOCK, core->time, core, p, devices[io->device].name);
+    }
 
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            
-            // it was a silver process and promoted to gold
-            } else {
+    // p may wake up on another core, the next process on this core needs a context switch anyway
+    core->lep = -1;
+}
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
+// moves the devices to time, the time of the core that is behind the others, so requests made before it on any core are known
+// a completed request puts its process into the ready queue of the least loaded core like an arrival, then the next request is started
+POLICY_INLINE void update_devices(const PolicyKind policy, Simulation *sim, int time) {
+    for (int d = 0; d < device_count; d++) {
+        DeviceQueue *device = &sim->devices[d];
+        while (1) {
+            if (device->serving != -1) {
+                if (device->free_at > time) {
+                    break;
+                }
+                int p = device->serving;
+                device->serving = -1;
+                sim->blocked_process_count--;
+                sim->processes.io_time[p] += device->free_at - sim->processes.blocked_at[p];
+                sim->processes.enter_to_ready[p] = device->free_at;
+                Core *target = least_loaded_core(sim);
+                policy_on_wakeup(policy, sim, target, p);
+                ready_queue_push(sim, target, p, policy_key(policy, sim, p));
+                if (sim->trace != NULL) {
+                    trace_event(sim, TRACE_WAKEUP, device->free_at, target, p, NULL);
                 }
             }
+            if (device->count == 0) {
+                break;
+            }
+            int start = sim->processes.blocked_at[device->queue[device->begin]];
+            if (start < device->free_at) {
+                start = device->free_at;
+            }
+            if (start > time) {
+                break;
+            }
+
+            // take the next request out of the queue and serve it, the head moves to its track first
+            int pos = device_pick(sim, &devices[d], device, start);
+            int p = device->queue[pos];
+            memmove(device->queue + device->begin + 1, device->queue + device->begin, (pos - device->begin) * sizeof(int));
+            device->begin++;
+            device->count--;
+            const Program *program = sim->processes.program[p];
+            int pc = sim->processes.PC[p] - 1;
+            const Instruction *io = &instructions[program->instruction[pc]];
+            int service = abs(io->track - device->head) * devices[d].seek_time + program->bursts[pc];
+            device->head = io->track;
+            device->serving = p;
+            device->free_at = start + service;
+            device->busy_time += service;
+            device->requests++;
+        }
+    }
+}
+
+// this function checks if any new process entered to system until the time of the core, if so it updates the ready queues
+// cores are simulated in time order, so all other cores are already at or past this time
+POLICY_INLINE void update_ready(const PolicyKind policy, Simulation *sim, Core *core) {
+    // move every process whose arrival is happened from pending arrivals to ready queue of the least loaded core
+    while (sim->pending_process_count > 0 && sim->processes.arrival_time[pending_top(sim)] <= core->time) {
+        int p = pending_top(sim);
+        Core *target = least_loaded_core(sim);
+        policy_on_arrival(policy, sim, target, p);
+        ready_queue_push(sim, target, p, policy_key(policy, sim, p));
+        pending_pop(sim);
+        PROFILE_COUNT(sim, arrivals);
+        if (sim->trace != NULL) {
+            trace_event(sim, TRACE_ARRIVAL, sim->processes.arrival_time[p], target, p, sim->processes.name[p]);
+        }
+    } 
+}
 
-            // if exit instruction is executed
-            if(p8[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time; // set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// this function handles executions on a core and necessary updates on processes after executions
+// a process without a quantum (platinum) runs to completion, others run until their quantum ends unless they terminate or a process arrives
+POLICY_INLINE void execute_process(const PolicyKind policy, Simulation *sim, Core *core) {
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
-        // if process name is P9
-        } else if (strcmp(scheduled.name, "P9") == 0) {
+    // take the scheduled process from the top of the queue
+    int current = core->ready_heap[0].process;
 
-            execution_time += p9[scheduled.PC]; // uddate execution time
-            scheduled.duration += p9[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+    // program of the process
+    const Program *program = sim->processes.program[current];
+    int program_len = program->length;
+    
+    // if this is the first process in the system or a new process is allowed to enter CPU, make a context switch
+    if (core->lep != current) {
+        if (sim->trace != NULL) {
+            trace_event(sim, TRACE_CONTEXT_SWITCH, core->time, core, current, NULL);
+        }
+        core->time += config.context_switch; // context switch  
+        core->ongoing_quantum = 0; 
+        core->context_switches++;
+        sim->processes.switch_count[current]++;
+        PROFILE_COUNT(sim, context_switches);
+        core->context_switch_time += config.context_switch;
+        if (sim->trace != NULL) {
+            trace_event(sim, TRACE_DISPATCH, core->time, core, current, NULL);
+        }
+    } 
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+    // update the last executed process
+    core->lep = current; 
+    policy_on_select(policy, sim, core, current);
+    if (sim->processes.first_run[current] == -1) {
+        sim->processes.first_run[current] = core->time; // response time is measured to here
+    }
 
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
+    // reset execution time to 0 
+    int execution_time = 0; 
 
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            
-            // it was a silver process and promoted to gold
-            } else {
+    // quantum time allowed for the process by the policy
+    int quantum = policy_quantum(policy, sim, current);
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
-            }
+    // the process runs on the CPU until its next I/O instruction at most (program end if it has none)
+    int stop = program->next_io[sim->processes.PC[current]];
 
-            // if exit instruction is executed
-            if(p9[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time; // set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+    // handle process without quantum (platinum) case
+    if(quantum == 0) {
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
+        // since this process has no quantum it will execute in an atomic fashion
+        // execute all instructions up to its next I/O request
+        execution_time = burst_between(program, sim->processes.PC[current], stop); // uddate execution time
+        sim->processes.duration[current] += execution_time; // update duration
+        sim->processes.PC[current] = stop; // move PC to the end or to the I/O instruction
+        core->busy_time += execution_time;
+        policy_on_run(policy, sim, current, execution_time);
+
+        core->time += execution_time; // update time of the core 
+        if (stop == program_len) {
+            exit_process(sim, core, current); // process terminated, delete it from ready queue
+        } else {
+            block_process(policy, sim, core, current); // process waits for the device, delete it from ready queue
+        }
+
+    // handle the processes with a quantum (gold or silver)
+    } else {
+
+        // only an arrival or a completed I/O request can take the CPU from the process before its quantum ends, so look ahead to the next one
+        int next_arrival = sim->pending_process_count > 0 ? sim->processes.arrival_time[pending_top(sim)] : INT_MAX;
+        if (device_count > 0) {
+            int next_io = next_device_event(sim);
+            if (next_io < next_arrival) {
+                next_arrival = next_io;
             }
+        }
 
-        // if process name is P10
-        } else if (strcmp(scheduled.name, "P10") == 0) {
+        // execute instructions until the quantum is completed, the process terminates or a process arrives
+        // after an arrival the process continues in the next call without a context switch if it is still on top of the ready queue
+        while (1) {
+            // run instructions up to the one that completes the quantum or is running when the next arrival happens
+            int budget = quantum - core->ongoing_quantum;
+            if (next_arrival - core->time < budget) {
+                budget = next_arrival - core->time;
+            }
+            int remaining = burst_between(program, sim->processes.PC[current], stop);
+            if (remaining < budget) { // a quantum longer than the rest of the program (srtf has no quantum) must not overflow the prefix sum target
+                budget = remaining;
+            }
+            int pc = advance_pc(program, sim->processes.PC[current], budget);
+            if (pc > stop) { // the I/O instruction is not run on the CPU
+                pc = stop;
+            }
 
-            execution_time += p10[scheduled.PC]; // uddate execution time
-            scheduled.duration += p10[scheduled.PC];  // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+            execution_time = burst_between(program, sim->processes.PC[current], pc); // uddate execution time
+            sim->processes.duration[current] += execution_time; // update duration
+            core->ongoing_quantum += execution_time; // update current quantum time
+            core->time += execution_time;  // update time of the core 
+            sim->processes.PC[current] = pc; // move PC
+            core->busy_time += execution_time;
+            policy_on_run(policy, sim, current, execution_time);
 
             // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 120) {
-                scheduled.quantum_counter++;  // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
+            if (core->ongoing_quantum >= quantum) {
+                core->ongoing_quantum = 0; // reset current quantum time
+                policy_on_quantum_expiry(policy, sim, core, current);
+                break;
             }
-            scheduled.PC++; // increment PC
 
-            // check if this was a silver process earlier
-            // if arrival and secondary arrival are equal then this process was gold earlier too
-            if(scheduled.secondary_arrival == scheduled.arrival_time) {
+            // stop if exit instruction is executed or the process reached an I/O instruction
+            if (sim->processes.PC[current] == stop) {
+                break;
+            }
 
-                // if quantum counter reaches 5, promote to platinum
-                if(scheduled.quantum_counter >= 5) {
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
+            // stop if a process arrived during the instruction, other cores must reach this time before it is added to a ready queue
+            if (core->time >= next_arrival) {
+                break;
+            }
+        }
 
-            // it was a silver process and promoted to gold
-            } else {
+        // if exit instruction is executed
+        if(sim->processes.PC[current] == program_len) { 
+            exit_process(sim, core, current); // process terminated, delete it from ready queue
 
-                // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                if(scheduled.quantum_counter >= 8) { 
-                    strcpy(scheduled.type, "PLATINUM"); 
-                    scheduled.secondary_arrival = global_time;// update its secondary arrival
-                }
+        // if the process reached an I/O instruction, even when its quantum ended there
+        } else if (sim->processes.PC[current] == stop) {
+            block_process(policy, sim, core, current); // process waits for the device, delete it from ready queue
+        
+        // process is not terminated
+        } else {
+            ready_queue_update(sim, core, current, policy_key(policy, sim, current)); // changes on process may move it in ready queue
+        }
+    }
+}
+
+// frees arrays of a simulation context
+void free_simulation(Simulation *sim) {
+    free(sim->processes.name);
+    free(sim->processes.priority);
+    free(sim->processes.arrival_time);
+    free(sim->processes.secondary_arrival);
+    free(sim->processes.completion_time);
+    free(sim->processes.type);
+    free(sim->processes.defined_type);
+    free(sim->processes.PC);
+    free(sim->processes.quantum_counter);
+    free(sim->processes.duration);
+    free(sim->processes.enter_to_ready);
+    free(sim->processes.program);
+    free(sim->processes.promotion_at);
+    free(sim->processes.name_key);
+    free(sim->processes.first_run);
+    free(sim->processes.switch_count);
+    free(sim->processes.promotion_time);
+    free(sim->processes.policy_state);
+    free(sim->processes.blocked_at);
+    free(sim->processes.io_time);
+    free(sim->pending);
+    free(sim->free_slots);
+    for (int c = 0; c < sim->core_count; c++) {
+        free(sim->cores[c].ready_heap);
+    }
+    free(sim->cores);
+    for (int d = 0; d < device_count; d++) {
+        free(sim->devices[d].queue);
+    }
+    free(sim->devices);
+    free(sim->heap_pos);
+    arena_free(&sim->arena);
+    memset(sim, 0, sizeof(*sim));
+}
+
+// resets the simulation state so a new definition file can be simulated, 
+// allocated arrays and loaded programs are kept and reused by the next run
+void reset_simulation(Simulation *sim) {
+    sim->processes.count = 0;
+    sim->pending_begin = 0;
+    sim->pending_process_count = 0;
+    sim->ready_process_count = 0;
+    sim->exited_process_count = 0;
+    sim->events = 0;
+    sim->random_state = 1; // runs of a definition file are repeatable
+    sim->total_waiting_time = 0;
+    sim->total_turnaround_time = 0;
+    sim->makespan = 0;
+    sim->free_slot_count = 0;
+    arena_reset(&sim->arena);
+    for (int c = 0; c < sim->core_count; c++) {
+        ReadyEntry *ready_heap = sim->cores[c].ready_heap;
+        memset(&sim->cores[c], 0, sizeof(Core));
+        sim->cores[c].ready_heap = ready_heap;
+        sim->cores[c].lep = -1;
+    }
+    sim->blocked_process_count = 0;
+    for (int d = 0; d < device_count; d++) {
+        DeviceQueue *device = &sim->devices[d];
+        device->begin = 0;
+        device->count = 0;
+        device->serving = -1;
+        device->free_at = 0;
+        device->head = 0;
+        device->direction = 1;
+        device->busy_time = 0;
+        device->requests = 0;
+    }
+}
+
+// prepares an empty simulation context with given number of cores
+void init_simulation(Simulation *sim, int core_count) {
+    memset(sim, 0, sizeof(*sim));
+    sim->core_count = core_count;
+    sim->cores = calloc(core_count, sizeof(Core));
+    sim->devices = calloc(device_count, sizeof(DeviceQueue));
+    if (sim->cores == NULL || (device_count > 0 && sim->devices == NULL)) {
+        exit(EXIT_FAILURE);
+    }
+    reset_simulation(sim);
+}
+
+// field of a definition line, it points into the mapped file so nothing is copied
+typedef struct {
+    const char *start;
+    int len;
+} Field;
+
+// parses a decimal integer field into value, returns -1 if it is not a number or does not fit in an int
+int parse_int(Field field, int *value) {
+    const char *c = field.start;
+    const char *end = field.start + field.len;
+    int negative = 0;
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = *c == '-';
+        c++;
+    }
+    if (c == end) {
+        return -1;
+    }
+    long long result = 0;
+    for (; c < end; c++) {
+        if (*c < '0' || *c > '9') {
+            return -1;
+        }
+        result = result * 10 + (*c - '0');
+        if (result > INT_MAX) {
+            return -1;
+        }
+    }
+    *value = negative ? (int)-result : (int)result;
+    return 0;
+}
+
+// prints an error for line line_number of the definition file at path, returns -2 for load_definition
+int definition_error(const char *path, int line_number, const char *message, Field field) {
+    fprintf(stderr, "%s:%d: %s '%.*s'\n", path, line_number, message, field.len, field.start);
+    return -2;
+}
+
+// returns a slot of the process table for a new process, slots of exited processes are reused first
+int alloc_process(Simulation *sim) {
+    if (sim->free_slot_count > 0) {
+        return sim->free_slots[--sim->free_slot_count];
+    }
+    // grow process table if it is full
+    if (sim->processes.count == sim->processes.capacity) {
+        grow_processes(sim);
+    }
+    return sim->processes.count++;
+}
+
+// sets the fields of process p that change while it is simulated to their values before its arrival
+void init_process_state(Simulation *sim, int p) {
+    int arrival = sim->processes.arrival_time[p];
+    int type = sim->processes.defined_type[p];
+    sim->processes.enter_to_ready[p] = arrival; // enter time to ready queue
+    sim->processes.secondary_arrival[p] = arrival;  // secondary arrival (in case of promotion)
+    sim->processes.type[p] = type; // type PLATINUM, GOLD, SILVER
+    sim->processes.promotion_at[p] = config.types[type].promotion; // quantum count of first promotion
+    sim->processes.completion_time[p] = -1; // completion time of process, -1 until it completes
+    sim->processes.PC[p] = 0; // program counter
+    sim->processes.quantum_counter[p] = 0; // number of times the process entered to CPU
+    sim->processes.duration[p] = 0; // total execution time of the process
+    sim->processes.first_run[p] = -1; // not executed yet
+    sim->processes.switch_count[p] = 0;
+    sim->processes.policy_state[p] = 0;
+    sim->processes.io_time[p] = 0; // not blocked yet
+    for (int t = 0; t < TYPE_COUNT; t++) {
+        sim->processes.promotion_time[p][t] = -1;
+    }
+    sim->heap_pos[p] = -1; // not in ready queue yet
+}
+
+// adds a process to sim, its name is the name_len characters at name and they fit in the process table
+// the caller adds the process to pending arrivals, returns index of the new process
+int add_process(Simulation *sim, const char *name, int name_len, int priority, int arrival, int type, const Program *program) {
+    int p = alloc_process(sim);
+    memcpy(sim->processes.name[p], name, name_len); // name P1, P2, P3 ... P10
+    sim->processes.name[p][name_len] = '\0';
+    sim->processes.name_key[p] = pack_name(sim->processes.name[p]); // packed name for ready queue ordering
+    sim->processes.priority[p] = priority; // priority
+    sim->processes.arrival_time[p] = arrival;  // arrival to system
+    sim->processes.defined_type[p] = type; // type PLATINUM, GOLD, SILVER
+    sim->processes.program[p] = program;
+    init_process_state(sim, p);
+    return p;
+}
+
+// parses the definition line from line to line_end in place and adds its process to sim
+// last_program is the program looked up for the previous line, consecutive processes mostly share it so the program registry lock is rarely taken
+// the caller adds the process to pending arrivals
+// returns index of the new process, -1 for a blank line and -2 if the line is malformed, the error is already printed then
+int add_definition_line(Simulation *sim, const char *path, int line_number, const char *line, const char *line_end, const Program **last_program) {
+    // split the line on spaces, tabs and carriage returns
+    Field fields[6];
+    int field_count = 0;
+    const char *c = line;
+    while (c < line_end) {
+        while (c < line_end && (*c == ' ' || *c == '\t' || *c == '\r')) {
+            c++;
+        }
+        if (c == line_end) {
+            break;
+        }
+        const char *start = c;
+        while (c < line_end && *c != ' ' && *c != '\t' && *c != '\r') {
+            c++;
+        }
+        if (field_count == 6) {
+            field_count++;
+            break;
+        }
+        fields[field_count].start = start;
+        fields[field_count].len = c - start;
+        field_count++;
+    }
+    if (field_count == 0) { // blank line
+        return -1;
+    }
+    if (field_count < 4 || field_count > 5) {
+        fprintf(stderr, "%s:%d: expected 4 or 5 fields, found %s%d\n", path, line_number, field_count > 6 ? "more than " : "", field_count > 6 ? 6 : field_count);
+        return -2;
+    }
+
+    // validate every field before the process is stored
+    int priority, arrival;
+    if (fields[0].len >= (int)sizeof(*sim->processes.name)) {
+        return definition_error(path, line_number, "process name is too long", fields[0]);
+    }
+    if (parse_int(fields[1], &priority) != 0) {
+        return definition_error(path, line_number, "invalid priority", fields[1]);
+    }
+    if (parse_int(fields[2], &arrival) != 0) {
+        return definition_error(path, line_number, "invalid arrival time", fields[2]);
+    }
+    if (arrival < 0) { // ready queue keys only hold non-negative times
+        return definition_error(path, line_number, "negative arrival time", fields[2]);
+    }
+    if (arrival > MAX_ARRIVAL_TIME) {
+        fprintf(stderr, "%s:%d: arrival time '%.*s' is after %d, the simulation clock would overflow\n", path, line_number, fields[2].len, fields[2].start, MAX_ARRIVAL_TIME);
+        return -2;
+    }
+    int type = parse_type(fields[3].start, fields[3].len);
+    if (type < 0) {
+        return definition_error(path, line_number, "unknown process type", fields[3]);
+    }
+    // program of the process, optional fifth field, process name is used as program name if it is omitted
+    Field program_field = field_count > 4 ? fields[4] : fields[0];
+    if (program_field.len >= (int)sizeof((*last_program)->name)) {
+        return definition_error(path, line_number, "program name is too long", program_field);
+    }
+    if (*last_program == NULL || (int)strlen((*last_program)->name) != program_field.len
+        || memcmp((*last_program)->name, program_field.start, program_field.len) != 0) {
+        char program_name[sizeof((*last_program)->name)];
+        memcpy(program_name, program_field.start, program_field.len);
+        program_name[program_field.len] = '\0';
+        char error[128];
+        const Program *program = try_load_program(program_name, error, sizeof(error));
+        if (program == NULL) { // a batch skips just this file, like any other malformed line
+            fprintf(stderr, "%s:%d: %s\n", path, line_number, error);
+            return -2;
+        }
+        *last_program = program;
+    }
+
+    return add_process(sim, fields[0].start, fields[0].len, priority, arrival, type, *last_program);
+}
+
+// reads processes in definition file at path into sim
+// the file is mapped and scanned once in place, lines are found with memchr and fields are not copied until they are stored
+// returns 0 on success, -1 if the file cannot be opened and -2 if a line is malformed, the error is already printed then
+int load_definition(Simulation *sim, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    if (size == 0) { // mmap rejects empty files, there is nothing to simulate anyway
+        close(fd);
+        return 0;
+    }
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    const Program *last_program = NULL;
+    int status = 0;
+    int line_number = 0;
+    const char *line = data;
+    const char *end = data + size;
+    while (line < end) {
+        const char *line_end = memchr(line, '\n', end - line);
+        if (line_end == NULL) {
+            line_end = end;
+        }
+        line_number++;
+        int p = add_definition_line(sim, path, line_number, line, line_end, &last_program);
+        if (p == -2) {
+            status = -2;
+            break;
+        }
+        if (p >= 0) {
+            // process waits for its arrival, pending arrivals are sorted once the whole file is read
+            sim->pending[sim->pending_begin + sim->pending_process_count++] = p;
+        }
+        line = line_end + 1;
+    }
+    pending_sort(sim);
+
+    munmap(data, size);
+    return status;
+}
+
+// definition file read in chunks while the simulation runs, it may be a pipe
+// lines must be sorted by arrival time, so only processes up to the first one arriving after the simulated time are read
+// and memory is bounded by the processes in the system, not by the length of the file
+struct DefinitionStream {
+    const char *path; // path for error messages, "-" for standard input
+    int fd;
+    char *buffer; // chunk of the file, a line is always complete in it before it is parsed
+    size_t capacity; // size of buffer, it grows for lines longer than a chunk
+    size_t begin; // start of unparsed data in buffer
+    size_t end; // end of data read into buffer
+    int eof; // 1 after the end of the file is read
+    int line_number; // number of lines parsed
+    int last_arrival; // arrival time of the last process read
+    const Program *last_program; // program of the last process read
+};
+
+// opens definition file at path for streaming, "-" is standard input, returns -1 if it cannot be opened
+int open_stream(DefinitionStream *stream, const char *path) {
+    memset(stream, 0, sizeof(*stream));
+    stream->path = path;
+    stream->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (stream->fd == -1) {
+        return -1;
+    }
+    stream->capacity = 1 << 16;
+    stream->buffer = malloc(stream->capacity);
+    if (stream->buffer == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+void close_stream(DefinitionStream *stream) {
+    if (stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+    }
+    free(stream->buffer);
+}
+
+// finds the next line in the stream, reading more of the file when the buffer has no complete line
+// returns 0 and sets line and line_end, or -1 at the end of the file
+int stream_next_line(DefinitionStream *stream, const char **line, const char **line_end) {
+    while (1) {
+        char *newline = memchr(stream->buffer + stream->begin, '\n', stream->end - stream->begin);
+        if (newline != NULL || (stream->eof && stream->begin < stream->end)) {
+            *line = stream->buffer + stream->begin;
+            *line_end = newline != NULL ? newline : stream->buffer + stream->end;
+            stream->begin = *line_end - stream->buffer + (newline != NULL);
+            return 0;
+        }
+        if (stream->eof) {
+            return -1;
+        }
+
+        // move the partial line to the front of the buffer, grow the buffer if the line fills it
+        memmove(stream->buffer, stream->buffer + stream->begin, stream->end - stream->begin);
+        stream->end -= stream->begin;
+        stream->begin = 0;
+        if (stream->end == stream->capacity) {
+            stream->capacity *= 2;
+            stream->buffer = realloc(stream->buffer, stream->capacity);
+            if (stream->buffer == NULL) {
+                exit(EXIT_FAILURE);
             }
+        }
+        ssize_t bytes = read(stream->fd, stream->buffer + stream->end, stream->capacity - stream->end);
+        if (bytes < 0) {
+            fprintf(stderr, "cannot read %s\n", stream->path);
+            exit(EXIT_FAILURE);
+        }
+        if (bytes == 0) {
+            stream->eof = 1;
+        } else {
+            stream->end += bytes;
+        }
+    }
+}
+
+// reads processes from the stream until one arrives after time, so every arrival up to time and the next arrival after it are pending
+// exits if a line is malformed or arrivals are not sorted, the simulation cannot go back in time
+void stream_fill(Simulation *sim, int time) {
+    DefinitionStream *stream = sim->stream;
+    const char *line, *line_end;
+    while ((sim->pending_process_count == 0 || stream->last_arrival <= time) && stream_next_line(stream, &line, &line_end) == 0) {
+        stream->line_number++;
+        int p = add_definition_line(sim, stream->path, stream->line_number, line, line_end, &stream->last_program);
+        if (p == -2) {
+            exit(EXIT_FAILURE);
+        }
+        if (p == -1) {
+            continue;
+        }
+        if (sim->processes.arrival_time[p] < stream->last_arrival) {
+            fprintf(stderr, "%s:%d: arrival time %d is before arrival time %d of the previous process\n", stream->path, stream->line_number, sim->processes.arrival_time[p], stream->last_arrival);
+            exit(EXIT_FAILURE);
+        }
+        stream->last_arrival = sim->processes.arrival_time[p];
+        pending_push(sim, p); // process waits for its arrival
+    }
+}
+
+// fields of a process that change while it is simulated, a checkpoint holds them for processes in ready queues and devices
+typedef struct {
+    int process; // index of the process in process table
+    int PC;
+    int quantum_counter;
+    int duration;
+    int enter_to_ready;
+    int secondary_arrival;
+    int promotion_at;
+    int first_run;
+    int switch_count;
+    int blocked_at;
+    int io_time;
+    int promotion_time[TYPE_COUNT];
+    uint64_t policy_state;
+    unsigned char type;
+} ProcessState;
+
+// state of a simulation between two iterations of the simulation loop
+// pending processes are not stored since they are reset with init_process_state, and terminated processes only left their times in the totals
+typedef struct {
+    int max_time; // largest core time, the run up to the checkpoint did not depend on processes arriving after it
+    long long events;
+    int pending_begin;
+    int pending_process_count;
+    int ready_process_count;
+    int blocked_process_count;
+    int exited_process_count;
+    long long total_waiting_time;
+    long long total_turnaround_time;
+    int makespan;
+    uint64_t random_state;
+    Core *cores; // cores, ready heaps are stored in entries
+    ReadyEntry *entries; // ready heaps of the cores one after the other
+    DeviceQueue *devices; // devices, waiting requests are stored in requests
+    int *requests; // waiting requests of the devices one after the other
+    ProcessState *states; // processes in ready queues and devices
+    int state_count;
+    QuantileSketch *sketches; // waiting, turnaround and response sketches of the metrics, NULL if quantiles are not collected
+    ArenaMark mark; // position of the simulation arena before the arrays of the checkpoint, dropping it releases them
+} Checkpoint;
+
+// checkpoints of a run in the order they are taken, their times never decrease
+struct CheckpointLog {
+    Checkpoint *checkpoints;
+    int count;
+    int capacity;
+    long long next_at; // number of events at which the next checkpoint is taken
+};
+
+// copies the changing fields of process p into state
+void save_process_state(Simulation *sim, int p, ProcessState *state) {
+    state->process = p;
+    state->PC = sim->processes.PC[p];
+    state->quantum_counter = sim->processes.quantum_counter[p];
+    state->duration = sim->processes.duration[p];
+    state->enter_to_ready = sim->processes.enter_to_ready[p];
+    state->secondary_arrival = sim->processes.secondary_arrival[p];
+    state->promotion_at = sim->processes.promotion_at[p];
+    state->first_run = sim->processes.first_run[p];
+    state->switch_count = sim->processes.switch_count[p];
+    state->blocked_at = sim->processes.blocked_at[p];
+    state->io_time = sim->processes.io_time[p];
+    memcpy(state->promotion_time, sim->processes.promotion_time[p], sizeof(state->promotion_time));
+    state->policy_state = sim->processes.policy_state[p];
+    state->type = sim->processes.type[p];
+}
+
+// copies state back into the process table
+void load_process_state(Simulation *sim, const ProcessState *state) {
+    int p = state->process;
+    sim->processes.PC[p] = state->PC;
+    sim->processes.quantum_counter[p] = state->quantum_counter;
+    sim->processes.duration[p] = state->duration;
+    sim->processes.enter_to_ready[p] = state->enter_to_ready;
+    sim->processes.secondary_arrival[p] = state->secondary_arrival;
+    sim->processes.promotion_at[p] = state->promotion_at;
+    sim->processes.first_run[p] = state->first_run;
+    sim->processes.switch_count[p] = state->switch_count;
+    sim->processes.blocked_at[p] = state->blocked_at;
+    sim->processes.io_time[p] = state->io_time;
+    memcpy(sim->processes.promotion_time[p], state->promotion_time, sizeof(state->promotion_time));
+    sim->processes.policy_state[p] = state->policy_state;
+    sim->processes.type[p] = state->type;
+}
+
+// frees the checkpoints of a log, their arrays are in the arena of the simulation and go with it
+void free_checkpoints(CheckpointLog *log) {
+    free(log->checkpoints);
+    memset(log, 0, sizeof(*log));
+}
+
+// adds a checkpoint of the current state to the log of the simulation
+// a checkpoint copies every ready and blocked process, so the next one is taken after at least as many events as it copied
+// and checkpoints cost O(1) per event however long the queues get
+void take_checkpoint(Simulation *sim) {
+    CheckpointLog *log = sim->checkpoints;
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 64;
+        log->checkpoints = grow_array(log->checkpoints, log->capacity, sizeof(Checkpoint));
+    }
+    Checkpoint *checkpoint = &log->checkpoints[log->count++];
+    checkpoint->events = sim->events;
+    checkpoint->pending_begin = sim->pending_begin;
+    checkpoint->pending_process_count = sim->pending_process_count;
+    checkpoint->ready_process_count = sim->ready_process_count;
+    checkpoint->blocked_process_count = sim->blocked_process_count;
+    checkpoint->exited_process_count = sim->exited_process_count;
+    checkpoint->total_waiting_time = sim->total_waiting_time;
+    checkpoint->total_turnaround_time = sim->total_turnaround_time;
+    checkpoint->makespan = sim->makespan;
+    checkpoint->random_state = sim->random_state;
+    checkpoint->state_count = sim->ready_process_count + sim->blocked_process_count;
+    checkpoint->mark = arena_mark(&sim->arena);
+    checkpoint->cores = arena_alloc(&sim->arena, sim->core_count * sizeof(Core));
+    checkpoint->entries = arena_alloc(&sim->arena, sim->ready_process_count * sizeof(ReadyEntry));
+    checkpoint->devices = arena_alloc(&sim->arena, device_count * sizeof(DeviceQueue));
+    checkpoint->requests = arena_alloc(&sim->arena, sim->blocked_process_count * sizeof(int));
+    checkpoint->states = arena_alloc(&sim->arena, checkpoint->state_count * sizeof(ProcessState));
+    checkpoint->sketches = NULL;
+    if (sim->metrics != NULL) {
+        // sketches only count observations, a copy of the counts is their whole state
+        checkpoint->sketches = arena_alloc(&sim->arena, 3 * sizeof(QuantileSketch));
+        checkpoint->sketches[0] = sim->metrics->waiting;
+        checkpoint->sketches[1] = sim->metrics->turnaround;
+        checkpoint->sketches[2] = sim->metrics->response;
+    }
+
+    int entry_count = 0, request_count = 0, state_count = 0;
+    checkpoint->max_time = 0;
+    memcpy(checkpoint->cores, sim->cores, sim->core_count * sizeof(Core));
+    for (int c = 0; c < sim->core_count; c++) {
+        Core *core = &sim->cores[c];
+        if (core->time > checkpoint->max_time) {
+            checkpoint->max_time = core->time;
+        }
+        if (core->ready_process_count == 0) {
+            continue;
+        }
+        memcpy(checkpoint->entries + entry_count, core->ready_heap, core->ready_process_count * sizeof(ReadyEntry));
+        entry_count += core->ready_process_count;
+        for (int i = 0; i < core->ready_process_count; i++) {
+            save_process_state(sim, core->ready_heap[i].process, &checkpoint->states[state_count++]);
+        }
+    }
+    if (device_count > 0) {
+        memcpy(checkpoint->devices, sim->devices, device_count * sizeof(DeviceQueue));
+    }
+    for (int d = 0; d < device_count; d++) {
+        DeviceQueue *device = &sim->devices[d];
+        if (device->count > 0) {
+            memcpy(checkpoint->requests + request_count, device->queue + device->begin, device->count * sizeof(int));
+            request_count += device->count;
+        }
+        for (int i = device->begin; i < device->begin + device->count; i++) {
+            save_process_state(sim, device->queue[i], &checkpoint->states[state_count++]);
+        }
+        if (device->serving != -1) {
+            save_process_state(sim, device->serving, &checkpoint->states[state_count++]);
+        }
+    }
+
+    log->next_at = sim->events + (checkpoint->state_count > config.checkpoint_interval ? checkpoint->state_count : config.checkpoint_interval);
+}
+
+// returns the simulation to checkpoint k of its log, later checkpoints are dropped since the run after k is simulated again
+void restore_checkpoint(Simulation *sim, int k) {
+    CheckpointLog *log = sim->checkpoints;
+    Checkpoint *checkpoint = &log->checkpoints[k];
+    sim->events = checkpoint->events;
+    sim->pending_begin = checkpoint->pending_begin;
+    sim->pending_process_count = checkpoint->pending_process_count;
+    sim->ready_process_count = checkpoint->ready_process_count;
+    sim->blocked_process_count = checkpoint->blocked_process_count;
+    sim->exited_process_count = checkpoint->exited_process_count;
+    sim->total_waiting_time = checkpoint->total_waiting_time;
+    sim->total_turnaround_time = checkpoint->total_turnaround_time;
+    sim->makespan = checkpoint->makespan;
+    sim->random_state = checkpoint->random_state;
+    if (checkpoint->sketches != NULL) {
+        sim->metrics->waiting = checkpoint->sketches[0];
+        sim->metrics->turnaround = checkpoint->sketches[1];
+        sim->metrics->response = checkpoint->sketches[2];
+    }
+
+    // processes that did not arrive at the checkpoint start over, the others get their state at the checkpoint
+    // every process has terminated at the end of a run, so only processes in the restored queues are in a ready heap
+    for (int i = sim->pending_begin; i < sim->pending_begin + sim->pending_process_count; i++) {
+        init_process_state(sim, sim->pending[i]);
+    }
+    for (int i = 0; i < checkpoint->state_count; i++) {
+        load_process_state(sim, &checkpoint->states[i]);
+    }
+    const ReadyEntry *entries = checkpoint->entries;
+    for (int c = 0; c < sim->core_count; c++) {
+        Core *core = &sim->cores[c];
+        ReadyEntry *ready_heap = core->ready_heap;
+        *core = checkpoint->cores[c];
+        core->ready_heap = ready_heap;
+        for (int i = 0; i < core->ready_process_count; i++) {
+            ready_heap[i] = *entries++;
+            sim->heap_pos[ready_heap[i].process] = i;
+        }
+    }
+    const int *requests = checkpoint->requests;
+    for (int d = 0; d < device_count; d++) {
+        DeviceQueue *device = &sim->devices[d];
+        int *queue = device->queue;
+        int capacity = device->capacity; // queues only grow, so it holds the requests of any earlier state
+        *device = checkpoint->devices[d];
+        device->queue = queue;
+        device->capacity = capacity;
+        device->begin = 0;
+        for (int i = 0; i < device->count; i++) {
+            queue[i] = *requests++;
+        }
+    }
+
+    if (k + 1 < log->count) {
+        arena_release(&sim->arena, log->checkpoints[k + 1].mark);
+    }
+    log->count = k + 1;
+    log->next_at = sim->events + (checkpoint->state_count > config.checkpoint_interval ? checkpoint->state_count : config.checkpoint_interval);
+}
+
+/* this function simulates the loaded sim->processes, while there exist a process that is not exited, it updates ready queue (heap ordered based on priorities)
+it calls the execute function above to get the scheduled process executed, after execution it checks if a preemption occurred and 
+makes necessary changes on preempted process and restores its place in the ready queue and calls execute function
+it stops early when every core reached time until or after max_events events, so an embedded context is simulated piece by piece
+the loop is inlined into run_simulation_until once for each policy*/
+POLICY_INLINE void simulate(const PolicyKind policy, Simulation *sim, int until, long long max_events) {
+    PROFILE_START(run);
+
+    // in streaming mode the first process is read before the loop, the loop ends when nothing is pending or ready
+    if (sim->stream != NULL) {
+        stream_fill(sim, 0);
+    }
 
-            // if exit instruction is executed
-            if(p10[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time; // set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+    // while there exist a process that is not terminated (either in a ready queue or not arrived to system yet)
+    while(sim->ready_process_count > 0 || sim->pending_process_count > 0 || sim->blocked_process_count > 0) {   
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+        // cores are simulated in time order, take the core that is behind the others
+        Core *core = next_core(sim);
+        if (core->time >= until || sim->events >= max_events) {
+            break;
         }
 
-    // handle process type is silver
-    } else { // silver 
+        // state between two iterations is saved from time to time, so what-if edits are simulated from there
+        if (sim->checkpoints != NULL && sim->events >= sim->checkpoints->next_at) {
+            take_checkpoint(sim);
+        }
+        sim->events++;
+        
+        // in streaming mode read the processes that arrived until the time of the core from the definition file
+        if (sim->stream != NULL) {
+            PROFILE_START(load);
+            stream_fill(sim, core->time);
+            PROFILE_STOP(sim, load);
+        }
 
-        // if process name is P1
-        if (strcmp(scheduled.name, "P1") == 0) {
+        // update ready queues, heaps keep them ordered by process keys
+        PROFILE_START(admit);
+        if (device_count > 0) {
+            update_devices(policy, sim, core->time);
+        }
+        update_ready(policy, sim, core); 
+        PROFILE_STOP(sim, admit);
+
+        // if the core has nothing to run, it takes a process from another core or waits until something can happen
+        if (core->ready_process_count == 0 && !steal_process(sim, core)) {
+            core->time = next_wakeup(sim, core);
+            PROFILE_COUNT(sim, idle_wakeups);
+            continue;
+        }
 
-            execution_time += p1[scheduled.PC]; // uddate execution time
-            scheduled.duration += p1[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+        // if a new process is scheduled and it is not the first process on the core
+        if(core->lep != -1 && core->ready_heap[0].process != core->lep) {
+            
+            int idx = core->lep; // to store index(in process table) of the last executed process
+            int quantum = policy_quantum(policy, sim, idx); // quantum time allowed for it by the policy
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time;// update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+            // if it is still in ready queue (not terminated), it has a quantum and it is preempted before its allowed quantum time
+            if (sim->heap_pos[idx] != -1 && quantum > 0 && core->ongoing_quantum < quantum && core->ongoing_quantum > 0) {
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time; // update its secondary arrival
-            }
-            
-            // if exit instruction is executed
-            if(p1[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
-
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
+                PROFILE_COUNT(sim, preemptions);
+                if (sim->trace != NULL) {
+                    trace_event(sim, TRACE_PREEMPTION, core->time, core, idx, NULL);
+                }
+                policy_on_preempt(policy, sim, core, idx);
+
+                // restore place of preempted process in ready queue as updates on it may change things
+                ready_queue_update(sim, core, idx, policy_key(policy, sim, idx));  
             }
 
-        // if process name is P2
-        } else if (strcmp(scheduled.name, "P2") == 0) {
+        }
+        
+        // excute first process in the sorted ready queue of the core
+        PROFILE_COUNT(sim, executions);
+        PROFILE_START(execute);
+        execute_process(policy, sim, core); 
+        PROFILE_STOP(sim, execute);
+    }
+    PROFILE_STOP(sim, run);
+}
 
-            execution_time += p2[scheduled.PC]; // uddate execution time
-            scheduled.duration += p2[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// simulates the loaded processes with the policy of the simulation until every core reached time until or max_events events were simulated
+// each case is a copy of the loop specialized for its policy
+void run_simulation_until(Simulation *sim, int until, long long max_events) {
+    switch (sim->policy) {
+    case POLICY_PRIORITY:
+        simulate(POLICY_PRIORITY, sim, until, max_events);
+        break;
+    case POLICY_FCFS:
+        simulate(POLICY_FCFS, sim, until, max_events);
+        break;
+    case POLICY_SJF:
+        simulate(POLICY_SJF, sim, until, max_events);
+        break;
+    case POLICY_SRTF:
+        simulate(POLICY_SRTF, sim, until, max_events);
+        break;
+    case POLICY_MLFQ:
+        simulate(POLICY_MLFQ, sim, until, max_events);
+        break;
+    case POLICY_CFS:
+        simulate(POLICY_CFS, sim, until, max_events);
+        break;
+    case POLICY_LOTTERY:
+        simulate(POLICY_LOTTERY, sim, until, max_events);
+        break;
+    default:
+        break;
+    }
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+// simulates the loaded processes with the policy of the simulation until every process terminated
+void run_simulation(Simulation *sim) {
+    run_simulation_until(sim, INT_MAX, LLONG_MAX);
+}
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+// computes average waiting and turnaround times of exited processes
+void compute_averages(Simulation *sim, float *avg_waiting_time, float *avg_turnaround_time) {
+    *avg_waiting_time = (float)sim->total_waiting_time / sim->exited_process_count;
+    *avg_turnaround_time = (float)sim->total_turnaround_time / sim->exited_process_count;
+}
 
-            // if exit instruction is executed
-            if(p2[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// prints an average as integer or if floating number use 1 digit after decimal point, followed by end character
+void print_average(FILE *out, float average, char end) {
+    if (fmod(average, 1) == 0) {
+        fprintf(out, "%d%c", (int)average, end);
+    } else {
+        fprintf(out, "%.1f%c", average, end);
+    }
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// prints p50, p95 and p99 of waiting, turnaround and response times, one line per metric
+void print_quantiles(FILE *out, Metrics *metrics) {
+    const char *names[3] = {"waiting", "turnaround", "response"};
+    QuantileSketch *sketches[3] = {&metrics->waiting, &metrics->turnaround, &metrics->response};
+    for (int m = 0; m < 3; m++) {
+        fprintf(out, "%s ", names[m]);
+        for (int i = 0; i < QUANTILE_COUNT; i++) {
+            fprintf(out, "p%d ", (int)(quantile_levels[i] * 100 + 0.5));
+            // estimates are rounded to the precision of print_average, so a whole estimate is printed as an integer
+            print_average(out, round(quantile_value(sketches[m], quantile_levels[i]) * 10) / 10, i + 1 < QUANTILE_COUNT ? ' ' : '\n');
+        }
+    }
+}
 
-        // if process name is P3
-        } else if (strcmp(scheduled.name, "P3") == 0) {
+#ifdef SCHEDULER_PROFILE
+// profile of all batch runs, workers add the profiles of their simulations to it when they finish
+Profile batch_profile;
+pthread_mutex_t batch_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// adds counters and timers of profile to total
+void merge_profile(Profile *total, const Profile *profile) {
+#define PROFILE_MERGE_COUNTER(name) total->name += profile->name;
+#define PROFILE_MERGE_TIMER(name) total->cycles.name += profile->cycles.name;
+    PROFILE_COUNTERS(PROFILE_MERGE_COUNTER)
+    PROFILE_TIMERS(PROFILE_MERGE_TIMER)
+#undef PROFILE_MERGE_COUNTER
+#undef PROFILE_MERGE_TIMER
+}
 
-            execution_time += p3[scheduled.PC]; // uddate execution time
-            scheduled.duration += p3[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// prints the profile as a report, one counter or timer per line
+// admit and execute are parts of run, load and sort are outside of it unless the definition file is streamed
+void print_profile(FILE *out, const Profile *profile) {
+    fprintf(out, "profile\n");
+#define PROFILE_PRINT_COUNTER(name) fprintf(out, "  %-20s %15llu\n", #name, (unsigned long long)profile->name);
+#define PROFILE_PRINT_TIMER(name) fprintf(out, "  %-20s %15llu cycles\n", #name, (unsigned long long)profile->cycles.name);
+    PROFILE_COUNTERS(PROFILE_PRINT_COUNTER)
+    PROFILE_TIMERS(PROFILE_PRINT_TIMER)
+#undef PROFILE_PRINT_COUNTER
+#undef PROFILE_PRINT_TIMER
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+// writes the profile as a JSON object with "counters" and "cycles" objects
+void write_profile_json(FILE *out, const Profile *profile) {
+    const char *separator = "";
+    fprintf(out, "{\"counters\": {");
+#define PROFILE_JSON_COUNTER(name) fprintf(out, "%s\"%s\": %llu", separator, #name, (unsigned long long)profile->name); separator = ", ";
+#define PROFILE_JSON_TIMER(name) fprintf(out, "%s\"%s\": %llu", separator, #name, (unsigned long long)profile->cycles.name); separator = ", ";
+    PROFILE_COUNTERS(PROFILE_JSON_COUNTER)
+    separator = "";
+    fprintf(out, "}, \"cycles\": {");
+    PROFILE_TIMERS(PROFILE_JSON_TIMER)
+#undef PROFILE_JSON_COUNTER
+#undef PROFILE_JSON_TIMER
+    fprintf(out, "}}\n");
+}
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+// prints the profile to stderr at exit, or writes it as JSON to json_path if it is not NULL
+void report_profile(const Profile *profile, const char *json_path) {
+    if (json_path == NULL) {
+        print_profile(stderr, profile);
+        return;
+    }
+    FILE *out = fopen(json_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "cannot create %s\n", json_path);
+        exit(EXIT_FAILURE);
+    }
+    write_profile_json(out, profile);
+    fclose(out);
+}
+#endif
 
-            // if exit instruction is executed
-            if(p3[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// comparison function used in qsort function to order definition file paths
+int cmp_path(const void *left, const void *right) {
+    return strcmp(*(char *const *)left, *(char *const *)right);
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// adds a copy of path to a growable list of paths
+void add_path(char ***paths, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *paths = realloc(*paths, *capacity * sizeof(char *));
+        if (*paths == NULL) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    (*paths)[(*count)++] = strdup(path);
+}
 
-        // if process name is P4
-        } else if (strcmp(scheduled.name, "P4") == 0) {
+// distributions of burst times in Monte-Carlo mode, the burst time of an instruction in instructions.txt is the mean of its samples
+typedef enum {
+    DISTRIBUTION_UNIFORM, // uniform around the mean, its width gives the coefficient of variation
+    DISTRIBUTION_NORMAL, // normal, samples below 0 become 0 (less than 0.02% of the mean at the largest cv)
+    DISTRIBUTION_LOGNORMAL, // lognormal, always positive with a long tail
+    DISTRIBUTION_EXPONENTIAL, // exponential, its coefficient of variation is always 1
+    DISTRIBUTION_COUNT
+} Distribution;
 
-            execution_time += p4[scheduled.PC]; // uddate execution time
-            scheduled.duration += p4[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+const char *distribution_names[DISTRIBUTION_COUNT] = {"uniform", "normal", "lognormal", "exponential"};
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+// largest coefficient of variation in percent of each distribution: a uniform sample is negative above 1 / sqrt(3),
+// a normal one is below 0 more than 3 standard deviations from the mean above 33%, an exponential one has only 100
+const int distribution_max_cv[DISTRIBUTION_COUNT] = {57, 33, INT_MAX, 100};
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+// sampler of burst times, each replication draws new burst and service times for every instruction of every process
+typedef struct {
+    Distribution distribution;
+    double cv; // coefficient of variation, standard deviation of a sample divided by its mean
+    uint64_t seed; // replication r starts its generator from seed and r, so results do not depend on the number of threads
+} BurstSampler;
+
+// returns a standard normal random number (Box-Muller)
+double random_normal(uint64_t *state) {
+    double radius = sqrt(-2 * log(random_uniform(state)));
+    return radius * cos(2 * M_PI * random_uniform(state));
+}
 
-            // if exit instruction is executed
-            if(p4[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+// returns a burst time drawn from the distribution of the sampler with given mean
+int sample_burst(const BurstSampler *sampler, int mean, uint64_t *state) {
+    if (mean == 0) {
+        return 0;
+    }
+    double cv = sampler->cv;
+    double sample;
+    switch (sampler->distribution) {
+    case DISTRIBUTION_UNIFORM: {
+        double width = cv * sqrt(3.0); // half width relative to the mean, at most 1 so samples stay non-negative
+        sample = mean * (1 - width + 2 * width * random_uniform(state));
+        break;
+    }
+    case DISTRIBUTION_NORMAL:
+        sample = mean * (1 + cv * random_normal(state));
+        break;
+    case DISTRIBUTION_LOGNORMAL: {
+        double variance = log(1 + cv * cv); // of the logarithm, its mean is chosen so the samples have the given mean
+        sample = mean * exp(sqrt(variance) * random_normal(state) - variance / 2);
+        break;
+    }
+    default:
+        sample = -mean * log(random_uniform(state));
+        break;
+    }
+    // a process runs all its instructions on one clock, so a sample is kept far below INT_MAX
+    if (sample < 0) {
+        return 0;
+    }
+    return sample < 1e8 ? (int)lround(sample) : 100000000;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// gives every process of sim its own copy of its program with burst times drawn by the sampler, the copies live in the arena of the run
+// the generator of replication r also seeds the lottery policy, so replications are independent runs
+void sample_programs(Simulation *sim, const BurstSampler *sampler, int replication) {
+    uint64_t state = sampler->seed + replication;
+    state = random_next(&state);
+    for (int p = 0; p < sim->processes.count; p++) {
+        const Program *program = sim->processes.program[p];
+        int length = program->length;
+        Program *copy = alloc_program(program->name, length, &sim->arena);
+        memcpy(copy->instruction, program->instruction, length * sizeof(int));
+        memcpy(copy->next_io, program->next_io, (length + 1) * sizeof(int));
+        for (int i = 0; i < length; i++) {
+            copy->bursts[i] = sample_burst(sampler, program->bursts[i], &state);
+        }
+        build_prefix(copy);
+        sim->processes.program[p] = copy;
+    }
+    sim->random_state = random_next(&state);
+}
 
-        // if process name is P5
-        } else if (strcmp(scheduled.name, "P5") == 0) { 
+// result of the simulation of one definition file in batch mode, or of one replication in Monte-Carlo mode
+typedef struct {
+    int status; // 0 if simulated, -1 if the file cannot be opened, -2 if it is malformed
+    float avg_waiting_time;
+    float avg_turnaround_time;
+} BatchResult;
 
-            execution_time += p5[scheduled.PC]; // uddate execution time
-            scheduled.duration += p5[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// jobs of a worker thread, a job is the index of a definition file and jobs not taken yet are a contiguous range
+// the worker takes jobs from the front of its range, an idle worker steals the back half of another worker's range
+typedef struct {
+    pthread_mutex_t lock; // guards begin and end
+    int begin; // first job not taken yet
+    int end; // one past the last job
+} JobQueue;
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++;// increment PC
+// batch state shared by worker threads
+typedef struct {
+    char **paths; // definition files
+    BatchResult *results; // result of each definition file
+    JobQueue *queues; // job queue of each worker
+    int worker_count; // number of workers
+    int core_count; // number of cores of each simulation
+    PolicyKind policy; // scheduling policy of each simulation
+    const BurstSampler *sampler; // in Monte-Carlo mode a job is a replication of the only definition file, NULL in batch mode
+} WorkerPool;
+
+// arguments of a worker thread
+typedef struct {
+    WorkerPool *pool;
+    int id; // index of the worker, and of its job queue
+} Worker;
+
+// takes the next job of a worker, it steals from other workers when its own queue is empty, returns -1 when there is no job left
+int next_job(WorkerPool *pool, int id) {
+    JobQueue *own = &pool->queues[id];
+    int job = -1;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->begin < own->end) {
+        job = own->begin++;
+    }
+    pthread_mutex_unlock(&own->lock);
+    if (job != -1) {
+        return job;
+    }
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+    // own queue is empty, steal back half of the first non empty queue of other workers
+    for (int i = 1; i < pool->worker_count; i++) {
+        JobQueue *victim = &pool->queues[(id + i) % pool->worker_count];
+        int begin = 0;
+        int end = 0;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end) {
+            begin = victim->begin + (victim->end - victim->begin) / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            // run the first stolen job and keep the rest in own queue, so others can steal from it
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin + 1;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return begin;
+        }
+    }
 
-            // if exit instruction is executed
-            if(p5[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+    // jobs are never added, so there is nothing left when every queue is empty
+    return -1;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+// worker thread, it simulates definition files with its own simulation context and stores their results
+void *worker_main(void *argument) {
+    Worker *worker = argument;
+    WorkerPool *pool = worker->pool;
+    Simulation simulation;
+    Simulation *sim = &simulation;
+    init_simulation(sim, pool->core_count);
+    sim->policy = pool->policy;
+
+    int job;
+    while ((job = next_job(pool, worker->id)) != -1) {
+        BatchResult *result = &pool->results[job];
+        reset_simulation(sim);
+        PROFILE_START(load);
+        result->status = load_definition(sim, pool->paths[pool->sampler != NULL ? 0 : job]);
+        PROFILE_STOP(sim, load);
+        if (result->status == 0) {
+            if (pool->sampler != NULL) {
+                sample_programs(sim, pool->sampler, job);
+            }
+            run_simulation(sim);
+            compute_averages(sim, &result->avg_waiting_time, &result->avg_turnaround_time);
+        }
+    }
 
-        // if process name is P6
-        } else if (strcmp(scheduled.name, "P6") == 0) {
+#ifdef SCHEDULER_PROFILE
+    pthread_mutex_lock(&batch_profile_lock);
+    merge_profile(&batch_profile, &sim->profile);
+    pthread_mutex_unlock(&batch_profile_lock);
+#endif
+    free_simulation(sim);
+    return NULL;
+}
 
-            execution_time += p6[scheduled.PC]; // uddate execution time
-            scheduled.duration += p6[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// simulates job_count definition files, or replications of paths[0] if sampler is not NULL, with thread_count worker threads
+// jobs are split evenly between workers at the start
+void run_workers(char **paths, BatchResult *results, int job_count, int thread_count, int core_count, PolicyKind policy, const BurstSampler *sampler) {
+    WorkerPool pool = {paths, results, NULL, thread_count, core_count, policy, sampler};
+    pool.queues = calloc(thread_count, sizeof(JobQueue));
+    Worker *workers = calloc(thread_count, sizeof(Worker));
+    pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+    if (pool.queues == NULL || workers == NULL || threads == NULL) {
+        exit(EXIT_FAILURE);
+    }
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+    for (int i = 0; i < thread_count; i++) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].begin = (int)((long long)job_count * i / thread_count);
+        pool.queues[i].end = (int)((long long)job_count * (i + 1) / thread_count);
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+    // first worker runs in the calling thread
+    for (int i = 1; i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "cannot create worker thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    worker_main(&workers[0]);
+    for (int i = 1; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
 
-            // if exit instruction is executed
-            if(p6[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+    for (int i = 0; i < thread_count; i++) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    free(pool.queues);
+    free(workers);
+    free(threads);
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+/* batch mode simulates many definition files in one run, source is either a directory (its def*.txt files are simulated in name order)
+or a manifest file listing one definition file path per line. instruction set and programs are read once and shared by all runs, 
+definition files are simulated by thread_count worker threads with work stealing, each simulation has core_count cores and uses policy, 
+one row is printed for each definition file in file order -> path, average waiting time, average turnaround time */
+int run_batch(const char *source, int thread_count, int core_count, PolicyKind policy) {
 
-        // if process name is P7
-        } else if (strcmp(scheduled.name, "P7") == 0) {
+    char **paths = NULL;
+    int path_count = 0;
+    int path_capacity = 0;
 
-            execution_time += p7[scheduled.PC]; // uddate execution time
-            scheduled.duration += p7[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+    struct stat source_stat;
+    if (stat(source, &source_stat) != 0) {
+        fprintf(stderr, "cannot open %s\n", source);
+        return EXIT_FAILURE;
+    }
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
+    // collect definition files from directory
+    if (S_ISDIR(source_stat.st_mode)) {
+        DIR *directory = opendir(source);
+        if (directory == NULL) {
+            fprintf(stderr, "cannot open %s\n", source);
+            return EXIT_FAILURE;
+        }
+        struct dirent *entry;
+        char path[4096];
+        while ((entry = readdir(directory)) != NULL) {
+            size_t name_len = strlen(entry->d_name);
+            if (strncmp(entry->d_name, "def", 3) == 0 && name_len > 4 && strcmp(entry->d_name + name_len - 4, ".txt") == 0) {
+                snprintf(path, sizeof(path), "%s/%s", source, entry->d_name);
+                add_path(&paths, &path_count, &path_capacity, path);
             }
-            scheduled.PC++; // increment PC
+        }
+        closedir(directory);
+        qsort(paths, path_count, sizeof(char *), cmp_path);
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
+    // collect definition files from manifest
+    } else {
+        FILE *manifest = fopen(source, "r");
+        if (manifest == NULL) {
+            fprintf(stderr, "cannot open %s\n", source);
+            return EXIT_FAILURE;
+        }
+        char *line = NULL;
+        size_t len = 0;
+        while (getline(&line, &len, manifest) != -1) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] != '\0') {
+                add_path(&paths, &path_count, &path_capacity, line);
             }
+        }
+        free(line);
+        fclose(manifest);
+    }
 
-            // if exit instruction is executed
-            if(p7[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+    // simulate definition files in worker threads, results are kept in file order
+    BatchResult *results = calloc(path_count > 0 ? path_count : 1, sizeof(BatchResult));
+    if (results == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    run_workers(paths, results, path_count, thread_count, core_count, policy, NULL);
+
+    // print one row per definition file in file order
+    for (int i = 0; i < path_count; i++) {
+        if (results[i].status == -1) {
+            fprintf(stderr, "cannot open %s\n", paths[i]);
+        } else if (results[i].status != 0) {
+            // malformed definition file, load_definition already reported the line
+        } else {
+            fprintf(stdout, "%s ", paths[i]);
+            print_average(stdout, results[i].avg_waiting_time, ' ');
+            print_average(stdout, results[i].avg_turnaround_time, '\n');
+        }
+        free(paths[i]);
+    }
+    free(paths);
+    free(results);
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
+    return EXIT_SUCCESS;
+}
 
-        // if process name is P8
-        } else if (strcmp(scheduled.name, "P8") == 0) {
+// returns the 97.5% quantile of Student's t distribution with df degrees of freedom, it gives 95% confidence intervals
+double t_quantile(int df) {
+    static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+                                     2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df <= 30) {
+        return table[df - 1];
+    }
+    // Cornish-Fisher expansion around the normal quantile, it agrees with tables to three decimals from 30 degrees of freedom
+    double z = 1.959964;
+    return z + (z * z * z + z) / (4.0 * df) + (5 * pow(z, 5) + 16 * z * z * z + 3 * z) / (96.0 * df * df);
+}
 
-            execution_time += p8[scheduled.PC]; // uddate execution time
-            scheduled.duration += p8[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// prints the mean of values and its 95% confidence interval -> name mean value ci95 low high
+void print_interval(const char *name, const double *values, int count) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    double mean = sum / count;
+    double squares = 0;
+    for (int i = 0; i < count; i++) {
+        squares += (values[i] - mean) * (values[i] - mean);
+    }
+    double half_width = t_quantile(count - 1) * sqrt(squares / (count - 1) / count);
+    printf("%s mean %.1f ci95 %.1f %.1f\n", name, mean, mean - half_width, mean + half_width);
+}
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+/* Monte-Carlo mode simulates definition.txt replications times, each replication draws the burst time of every instruction of every process
+from the distribution of sampler, replications are run by thread_count worker threads and each has its own random number generator,
+it prints the mean and 95% confidence interval of the average waiting and turnaround times over the replications */
+int run_monte_carlo(int replications, const BurstSampler *sampler, int thread_count, int core_count, PolicyKind policy) {
+    char *paths[] = {"definition.txt"};
+    BatchResult *results = calloc(replications, sizeof(BatchResult));
+    double *waiting_times = calloc(replications, sizeof(double));
+    double *turnaround_times = calloc(replications, sizeof(double));
+    if (results == NULL || waiting_times == NULL || turnaround_times == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    run_workers(paths, results, replications, thread_count < replications ? thread_count : replications, core_count, policy, sampler);
+
+    // every replication reads the same file, so they all fail the same way
+    int status = EXIT_SUCCESS;
+    if (results[0].status == -1) {
+        fprintf(stderr, "cannot open %s\n", paths[0]);
+        status = EXIT_FAILURE;
+    } else if (results[0].status != 0) {
+        status = EXIT_FAILURE; // load_definition already reported the line
+    } else {
+        for (int r = 0; r < replications; r++) {
+            waiting_times[r] = results[r].avg_waiting_time;
+            turnaround_times[r] = results[r].avg_turnaround_time;
+        }
+        print_interval("waiting_time", waiting_times, replications);
+        print_interval("turnaround_time", turnaround_times, replications);
+    }
+    free(results);
+    free(waiting_times);
+    free(turnaround_times);
+    return status;
+}
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+// simulates definition.txt once with each policy and prints one row per policy -> policy, average waiting time, average turnaround time
+int compare_policies(int core_count) {
+    Simulation simulation;
+    Simulation *sim = &simulation;
+    init_simulation(sim, core_count);
+    for (int k = 0; k < POLICY_COUNT; k++) {
+        reset_simulation(sim);
+        sim->policy = k;
+        if (load_definition(sim, "definition.txt") != 0) {
+            exit(EXIT_FAILURE);
+        }
+        run_simulation(sim);
 
-            // if exit instruction is executed
-            if(p8[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+        float avg_waiting_time, avg_turnaround_time;
+        compute_averages(sim, &avg_waiting_time, &avg_turnaround_time);
+        printf("%s ", policy_names[k]);
+        print_average(stdout, avg_waiting_time, ' ');
+        print_average(stdout, avg_turnaround_time, '\n');
+    }
+    free_simulation(sim);
+    return EXIT_SUCCESS;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
-        
-        // if process name is P9
-        } else if (strcmp(scheduled.name, "P9") == 0) {
+// moves process p to its place in pending arrivals after its arrival time changed, it did not arrive yet
+void pending_reorder(Simulation *sim, int p) {
+    int *pending = sim->pending;
+    int begin = sim->pending_begin;
+    int end = sim->pending_begin + sim->pending_process_count;
+    int i = begin;
+    while (pending[i] != p) {
+        i++;
+    }
+    // move earlier processes up or later processes down until p is in order
+    while (i > begin && pending_less(sim, p, pending[i - 1])) {
+        pending[i] = pending[i - 1];
+        i--;
+    }
+    while (i + 1 < end && pending_less(sim, pending[i + 1], p)) {
+        pending[i] = pending[i + 1];
+        i++;
+    }
+    pending[i] = p;
+}
 
-            execution_time += p9[scheduled.PC]; // uddate execution time
-            scheduled.duration += p9[scheduled.PC]; // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// applies what-if edits read from path (- for standard input) to the simulated definition, each on top of the previous ones
+// each line is "name priority|arrival|type value", after an edit the run is simulated again from the last checkpoint before any core
+// reached the (old or new) arrival time of the edited process, and the edit is printed with the new average waiting and turnaround times
+// and with -q the new latency quantiles, the checkpoints hold the quantile sketches as well
+// returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be opened or an edit is invalid
+int run_what_if(Simulation *sim, const char *path) {
+    FILE *filepointer = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (filepointer == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return EXIT_FAILURE;
+    }
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+    char line[256];
+    int line_number = 0;
+    int status = EXIT_SUCCESS;
+    while (status == EXIT_SUCCESS && fgets(line, sizeof(line), filepointer) != NULL) {
+        line_number++;
+        char name[64], field[16], value[32];
+        int fields = sscanf(line, "%63s %15s %31s", name, field, value);
+        if (fields == EOF) { // blank line
+            continue;
+        }
+        if (fields != 3) {
+            fprintf(stderr, "%s:%d: expected name priority|arrival|type value\n", path, line_number);
+            status = EXIT_FAILURE;
+            break;
+        }
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time;// update its secondary arrival
-            }
+        // edited process, names are unique in a definition file
+        int p = 0;
+        while (p < sim->processes.count && strcmp(sim->processes.name[p], name) != 0) {
+            p++;
+        }
+        if (p == sim->processes.count) {
+            fprintf(stderr, "%s:%d: unknown process %s\n", path, line_number, name);
+            status = EXIT_FAILURE;
+            break;
+        }
 
-            // if exit instruction is executed
-            if(p9[scheduled.PC - 1] == 10) { 
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+        // nothing before the arrival of the process depends on it, so the run is replayed from the last checkpoint before it
+        int affected = sim->processes.arrival_time[p];
+        Field number = {value, (int)strlen(value)};
+        int new_value;
+        if (strcmp(field, "priority") == 0 && parse_int(number, &new_value) == 0) {
+            sim->processes.priority[p] = new_value;
+        } else if (strcmp(field, "arrival") == 0 && parse_int(number, &new_value) == 0 && new_value >= 0 && new_value <= MAX_ARRIVAL_TIME) {
+            if (new_value < affected) {
+                affected = new_value;
+            }
+            sim->processes.arrival_time[p] = new_value;
+        } else if (strcmp(field, "type") == 0 && (new_value = parse_type(value, (int)strlen(value))) >= 0) {
+            sim->processes.defined_type[p] = new_value;
+        } else if (strcmp(field, "priority") != 0 && strcmp(field, "arrival") != 0 && strcmp(field, "type") != 0) {
+            fprintf(stderr, "%s:%d: unknown field %s, expected priority, arrival or type\n", path, line_number, field);
+            status = EXIT_FAILURE;
+            break;
+        } else {
+            fprintf(stderr, "%s:%d: invalid %s '%s'\n", path, line_number, field, value);
+            status = EXIT_FAILURE;
+            break;
+        }
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
+        // the first checkpoint is taken before anything is simulated, so it is always valid
+        CheckpointLog *log = sim->checkpoints;
+        int low = 0, high = log->count - 1;
+        while (low < high) {
+            int mid = low + (high - low + 1) / 2;
+            if (log->checkpoints[mid].max_time < affected) {
+                low = mid;
             } else {
-                ready_processes[0] = scheduled; // update changes on process
+                high = mid - 1;
             }
+        }
+        restore_checkpoint(sim, low);
+        if (strcmp(field, "arrival") == 0) {
+            pending_reorder(sim, p);
+        }
+        run_simulation(sim);
+
+        float avg_waiting_time, avg_turnaround_time;
+        compute_averages(sim, &avg_waiting_time, &avg_turnaround_time);
+        printf("%s %s %s ", name, field, value);
+        print_average(stdout, avg_waiting_time, ' ');
+        print_average(stdout, avg_turnaround_time, '\n');
+        if (sim->metrics != NULL) {
+            print_quantiles(stdout, sim->metrics);
+        }
+        fflush(stdout);
+    }
 
-        // if process name is P10
-        } else if (strcmp(scheduled.name, "P10") == 0) {
+    if (filepointer != stdin) {
+        fclose(filepointer);
+    }
+    return status;
+}
 
-            execution_time += p10[scheduled.PC]; // uddate execution time
-            scheduled.duration += p10[scheduled.PC];  // update duration
-            ongoing_quantum += execution_time;// update current quantum time
-            global_time += execution_time;  // update global time 
+// embedding interface declared in libscheduler.h, the library is this file built with SCHEDULER_LIBRARY so main is left out
 
-            // check if process completed its allowed quantum time 
-            if (ongoing_quantum >= 80) {
-                scheduled.quantum_counter++; // increment quantum counter 
-                scheduled.enter_to_ready = global_time; // update enter_to_ready for round robin
-                ongoing_quantum = 0; // reset current quantum time
-            }
-            scheduled.PC++; // increment PC
+// simulation context of the library
+struct SchedulerContext {
+    Simulation sim;
+    const Program *last_program; // program of the last added process, consecutive processes mostly share it
+    int time; // largest time a core reached by simulating, processes arriving before it can no longer be added
+};
 
-            // if quantum counter reaches 3, promote to gold
-            if(scheduled.quantum_counter >= 3) {
-                strcpy(scheduled.type, "GOLD"); 
-                scheduled.secondary_arrival = global_time; // update its secondary arrival
-            }
+int scheduler_set_config(const char *key, int value) {
+    char text[16];
+    snprintf(text, sizeof(text), "%d", value);
+    return set_config(key, text);
+}
 
-            // if exit instruction is executed
-            if(p10[scheduled.PC - 1] == 10) {  
-                scheduled.completion_time = global_time;// set completion time of the process
-                exited_processes[exited_process_count++] = scheduled;// add the process to exited process list
+int scheduler_add_device(const char *name, int elevator, int seek_time) {
+    if (strlen(name) >= sizeof(devices->name) || seek_time < 0) {
+        return -1;
+    }
+    int d = find_device(name);
+    devices[d].elevator = elevator != 0;
+    devices[d].seek_time = seek_time;
+    return 0;
+}
 
-                // delete it from ready queue
-                for (int i = 0; i < ready_process_count - 1; ++i) {
-                    ready_processes[i] = ready_processes[i + 1]; 
-                }      
-                ready_process_count--;// decrement ready queue count
-            
-            // process is not terminated
-            } else {
-                ready_processes[0] = scheduled; // update changes on process
-            }
-        } 
+int scheduler_add_instruction(const char *name, int burst, const char *device, int track) {
+    if (strlen(name) >= sizeof(instructions->name) || (device != NULL && strlen(device) >= sizeof(devices->name))
+        || burst < 0 || track < 0 || lookup_instruction(name) != -1) {
+        return -1;
     }
+    Instruction instruction;
+    snprintf(instruction.name, sizeof(instruction.name), "%s", name);
+    instruction.burst = burst;
+    instruction.device = device != NULL ? find_device(device) : -1;
+    instruction.track = track;
+    add_instruction(&instruction);
+    return 0;
 }
 
-/* main function reads definition.txt file and fills processes array 
-then while there exist a process that is not exited, it updates ready queue and sorts it based on priorities
-it calls the execute function above to get the scheduled process executed, after execution it checks if a preemption occurred and 
-makes necessary changes on preempted process and sorts the ready queue again and calls execute function*/
+int scheduler_add_program(const char *name, const char *const *instruction_names, int length) {
+    if (strlen(name) >= sizeof((*programs)->name) || length <= 0) {
+        return -1;
+    }
+    int *indices = malloc(length * sizeof(int));
+    if (indices == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    int status = 0;
+    for (int i = 0; i < length && status == 0; i++) {
+        indices[i] = lookup_instruction(instruction_names[i]);
+        status = indices[i] == -1 ? -1 : 0;
+    }
+    if (status == 0 && program_error(indices, length) != NULL) {
+        status = -1;
+    }
+    if (status == 0) {
+        pthread_mutex_lock(&program_lock);
+        if (find_program(name) == NULL) {
+            register_program(build_program(name, indices, length));
+        } else {
+            status = -1;
+        }
+        pthread_mutex_unlock(&program_lock);
+    }
+    free(indices);
+    return status;
+}
 
-int main() {
+SchedulerContext *scheduler_create(int core_count, const char *policy) {
+    int kind = parse_policy(policy);
+    if (core_count < 1 || kind < 0) {
+        return NULL;
+    }
+    SchedulerContext *context = malloc(sizeof(SchedulerContext));
+    if (context == NULL) {
+        return NULL;
+    }
+    init_simulation(&context->sim, core_count);
+    context->sim.policy = kind;
+    context->sim.reuse_slots = 1; // processes keep coming, so the table only grows to the most processes in the system at once
+    context->last_program = NULL;
+    context->time = 0;
+    return context;
+}
 
-    // input reading
-    FILE *filepointer;
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t line_len; 
+void scheduler_destroy(SchedulerContext *context) {
+    free_simulation(&context->sim);
+    free(context);
+}
 
-    char *process_info[128]; 
-    char *token = NULL;
+void scheduler_reset(SchedulerContext *context) {
+    reset_simulation(&context->sim);
+    context->time = 0;
+}
 
-    filepointer = fopen("definition.txt", "r");
-    if (filepointer == NULL) {
-        exit(EXIT_FAILURE); }
+int scheduler_add_process(SchedulerContext *context, const char *name, int priority, int arrival, const char *type, const char *program) {
+    Simulation *sim = &context->sim;
+    int name_len = (int)strlen(name);
+    int process_type = parse_type(type, (int)strlen(type));
+    if (name_len >= (int)sizeof(*sim->processes.name) || strlen(program) >= sizeof((*programs)->name) || process_type < 0 || arrival < context->time || arrival > MAX_ARRIVAL_TIME) {
+        return -1;
+    }
+    if (context->last_program == NULL || strcmp(context->last_program->name, program) != 0) {
+        // a library never exits on bad input, a program that cannot be read only rejects the process
+        char error[128];
+        const Program *loaded = try_load_program(program, error, sizeof(error));
+        if (loaded == NULL) {
+            return -1;
+        }
+        context->last_program = loaded;
+    }
+    int p = add_process(sim, name, name_len, priority, arrival, process_type, context->last_program);
+    pending_push(sim, p); // process waits for its arrival
 
-    // while there exist a line to read
-    while ((line_len = getline(&line, &len, filepointer)) != -1) {
+    // a core that had nothing left to do went to sleep for good, it wakes up where the simulation stopped and then waits for the arrival
+    for (int c = 0; c < sim->core_count; c++) {
+        if (sim->cores[c].time == INT_MAX) {
+            sim->cores[c].time = context->time;
+        }
+    }
+    return 0;
+}
 
-        // parse the current line from spaces and new line characters and store tokens in process_info 
-        token = strtok(line, " \n");
-        int i = 0;
-        while(token) {
-            process_info[i++] = token;
-            token = strtok(NULL, " \n");
+// moves the time of the context to the latest time a core reached, cores with nothing left to do are not counted
+void update_context_time(SchedulerContext *context) {
+    for (int c = 0; c < context->sim.core_count; c++) {
+        int time = context->sim.cores[c].time;
+        if (time != INT_MAX && time > context->time) {
+            context->time = time;
         }
-        process_info[i] = NULL; // null end the array
-        
+    }
+}
 
-        strcpy(processes[process_count].name, process_info[0]); // name P1, P2, P3 ... P10
-        processes[process_count].priority = atoi(process_info[1]); // priority
-        processes[process_count].arrival_time = atoi(process_info[2]);  // arrival to system
-        processes[process_count].enter_to_ready = atoi(process_info[2]); // enter time to ready queue
-        processes[process_count].secondary_arrival = atoi(process_info[2]);  // secondary arrival (in case of promotion)
-        strcpy(processes[process_count].type, process_info[3]); // type PLATINUM, GOLD, SILVER
-        processes[process_count].completion_time = -1; // completion time of process, initially 0
-        processes[process_count].PC = 0; // program counter
-        processes[process_count].quantum_counter = 0; // number of times the process entered to CPU
-        processes[process_count].duration = 0; // total execution time of the process
+int scheduler_run_until(SchedulerContext *context, int time) {
+    Simulation *sim = &context->sim;
+    run_simulation_until(sim, time, LLONG_MAX);
+    update_context_time(context);
+    return sim->pending_process_count + sim->ready_process_count + sim->blocked_process_count;
+}
 
-        process_count++; // increment process count
-    }
-    
-    // close file
-    fclose(filepointer); 
-    if (line)
-        free(line);
-    
-    // while there exist a process that is not terminated (either in ready queue or not arrived to system yet)
-    while(ready_process_count > 0 || process_count > 0) {   
-        
-        // update ready queue
-        update_ready(); 
-        
-        // sort ready queue using cmp function 
-        qsort(ready_processes, ready_process_count, sizeof(Process), cmp);  
+int scheduler_step(SchedulerContext *context) {
+    Simulation *sim = &context->sim;
+    run_simulation_until(sim, INT_MAX, sim->events + 1);
+    update_context_time(context);
+    return sim->pending_process_count + sim->ready_process_count + sim->blocked_process_count;
+}
 
-        // if a new process is scheduled and it is not the first process in the system
-        if(strcmp(ready_processes[0].name, lep) != 0 && strcmp(lep, "") != 0) {
-            
-            char typ[10] = ""; // to store type of the last executed process
-            int idx = 0; // to store index(in ready queue) of the last executed process
-
-            // iterate over ready queue and find last executed process
-            for (int i = 0; i < ready_process_count; i++) {
-                if (strcmp(ready_processes[i].name, lep) == 0) {
-                    strcpy(typ, ready_processes[i].type); // store its type
-                    idx = i; // store its index
-                    break ; // break
-                }
-            }
+int scheduler_time(const SchedulerContext *context) {
+    return context->time;
+}
 
-            // if it was a gold process and preempted before its allowed quantum time
-            if (strcmp(typ, "GOLD") == 0 && ongoing_quantum < 120 && ongoing_quantum > 0) {
-
-                // set its enter to ready field to current time
-                ready_processes[idx].enter_to_ready = global_time; 
-
-                // increment its quantum counter
-                ready_processes[idx].quantum_counter++;
-
-                // check if this was a silver process earlier
-                // if arrival and secondary arrival are equal then this process was gold earlier 
-                if(ready_processes[idx].secondary_arrival == ready_processes[idx].arrival_time) {
-
-                    // if quantum counter reaches 5, promote to platinum
-                    if(ready_processes[idx].quantum_counter >= 5) {
-                        strcpy(ready_processes[idx].type, "PLATINUM"); 
-                        ready_processes[idx].secondary_arrival = global_time; // update its secondary arrival
-                    }
-                
-                // it was a silver process and promoted to gold
-                } else {
-
-                    // if quantum counter reaches 8, promote to platinum (8 because 3 of them are used to promote to gold from silver)
-                    if(ready_processes[idx].quantum_counter >= 8) { 
-                        strcpy(ready_processes[idx].type, "PLATINUM"); 
-                        ready_processes[idx].secondary_arrival = global_time; // update its secondary arrival
-                    }
-                }
+void scheduler_collect(const SchedulerContext *context, SchedulerMetrics *metrics) {
+    const Simulation *sim = &context->sim;
+    metrics->time = context->time;
+    metrics->exited = sim->exited_process_count;
+    metrics->remaining = sim->pending_process_count + sim->ready_process_count + sim->blocked_process_count;
+    metrics->total_waiting_time = sim->total_waiting_time;
+    metrics->total_turnaround_time = sim->total_turnaround_time;
+    metrics->average_waiting_time = sim->exited_process_count > 0 ? (double)sim->total_waiting_time / sim->exited_process_count : 0;
+    metrics->average_turnaround_time = sim->exited_process_count > 0 ? (double)sim->total_turnaround_time / sim->exited_process_count : 0;
+    metrics->makespan = sim->makespan;
+    metrics->events = sim->events;
+    metrics->context_switches = 0;
+    metrics->busy_time = 0;
+    for (int c = 0; c < sim->core_count; c++) {
+        metrics->context_switches += sim->cores[c].context_switches;
+        metrics->busy_time += sim->cores[c].busy_time;
+    }
+}
 
-                // sort ready queue again as updates on preempted process may change things
-                qsort(ready_processes, ready_process_count, sizeof(Process), cmp);  
-            
-            // if it was a silver process and preempted before its allowed quantum time
-            } else if (strcmp(typ, "SILVER") == 0 && ongoing_quantum < 80 && ongoing_quantum > 0) {
+#ifndef SCHEDULER_LIBRARY
+
+/* main function reads instruction set and simulates definition.txt file, then prints average waiting and turnaround times
+with -b option it simulates a directory or manifest of definition files in batch mode, -j sets the number of threads used in batch and Monte-Carlo modes
+-c sets the number of simulated CPU cores, each core has its own ready queue and idle cores take processes from busy ones
+with -s option the given definition file (or standard input for -) is read while simulating, its lines must be sorted by arrival time
+with -t option scheduling events are written to the given file as a binary trace, it is read with tracereader
+with -m option a row of metrics is written to the given CSV file for each terminated process, -q prints p50, p95 and p99 latencies
+with -S option statistics of the run are printed to stderr, the benchmark suite (make bench) reads them
+-p selects the scheduling policy (priority by default, fcfs, sjf, srtf, mlfq, cfs or lottery), -p all compares every policy on definition.txt
+-f reads quanta, context switch time and promotion thresholds from a configuration file, -o key=value sets one of them, later values win
+with -w option what-if edits are read from the given file (or standard input for -) after the run, each is simulated from a checkpoint
+-r replications[:seed] runs definition.txt many times in parallel (-j threads) with burst times drawn from -d distribution[:cv percent]
+(uniform, normal, lognormal or exponential, normal:20 by default) and prints mean and 95% confidence interval of the averages
+if instructions.txt has I/O instructions, CPU and device utilization and throughput are printed after the averages
+a build with SCHEDULER_PROFILE prints a profile report to stderr at exit, with -P option it is written to the given file as JSON */
+int main(int argc, char *argv[]) {
+
+    const char *batch_source = NULL; // directory or manifest given with -b option
+    const char *stream_path = NULL; // definition file given with -s option
+    const char *trace_path = NULL; // trace file given with -t option
+    int print_statistics = 0; // -S option
+    const char *metrics_path = NULL; // per-process CSV file given with -m option
+    int print_latency_quantiles = 0; // -q option
+    const char *what_if_path = NULL; // what-if edits given with -w option
+    int replications = 0; // -r option, 0 runs definition.txt once with the burst times of instructions.txt
+    BurstSampler sampler = {DISTRIBUTION_NORMAL, 0.2, 1}; // -d option and seed of -r
+    int policy = POLICY_PRIORITY; // -p option, -1 to compare all policies
+#ifdef SCHEDULER_PROFILE
+    const char *profile_path = NULL; // JSON profile file given with -P option
+#endif
+    int thread_count = get_nprocs(); // number of threads in batch and Monte-Carlo modes, all cores by default
+    int core_count = 1; // number of simulated CPU cores
+    int option;
+    while ((option = getopt(argc, argv, "b:j:c:s:t:SP:m:qp:f:o:w:r:d:")) != -1) {
+        switch (option) {
+        case 'b':
+            batch_source = optarg;
+            break;
+        case 'j':
+            thread_count = atoi(optarg);
+            if (thread_count < 1) {
+                fprintf(stderr, "number of threads must be positive\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'P':
+#ifdef SCHEDULER_PROFILE
+            profile_path = optarg;
+            break;
+#else
+            fprintf(stderr, "-P needs a build with profiling, run make scheduler_profile\n");
+            return EXIT_FAILURE;
+#endif
+        case 'p':
+            policy = strcmp(optarg, "all") == 0 ? -1 : parse_policy(optarg);
+            if (policy == -1 && strcmp(optarg, "all") != 0) {
+                fprintf(stderr, "unknown policy %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'f':
+            if (load_config(optarg) != 0) {
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'o': {
+            char *value = strchr(optarg, '=');
+            if (value == NULL) {
+                fprintf(stderr, "-o expects key=value, found %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            *value++ = '\0';
+            int status = set_config(optarg, value);
+            if (status != 0) {
+                config_error("-o", status, optarg, value);
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+        case 'm':
+            metrics_path = optarg;
+            break;
+        case 'q':
+            print_latency_quantiles = 1;
+            break;
+        case 'w':
+            what_if_path = optarg;
+            break;
+        case 'r': {
+            char *end;
+            long count = strtol(optarg, &end, 10);
+            unsigned long long seed = sampler.seed;
+            if (end != optarg && *end == ':' && end[1] >= '0' && end[1] <= '9') {
+                seed = strtoull(end + 1, &end, 10);
+            }
+            if (end == optarg || *end != '\0' || count < 2 || count > INT_MAX) {
+                fprintf(stderr, "-r expects replications[:seed] with at least 2 replications, found %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            replications = count;
+            sampler.seed = seed;
+            break;
+        }
+        case 'd': {
+            const char *colon = strchr(optarg, ':');
+            size_t name_len = colon != NULL ? (size_t)(colon - optarg) : strlen(optarg);
+            int distribution = 0;
+            while (distribution < DISTRIBUTION_COUNT && (strlen(distribution_names[distribution]) != name_len
+                   || strncmp(distribution_names[distribution], optarg, name_len) != 0)) {
+                distribution++;
+            }
+            long cv_percent = distribution == DISTRIBUTION_EXPONENTIAL ? 100 : 20;
+            char *end = NULL;
+            if (colon != NULL) {
+                cv_percent = strtol(colon + 1, &end, 10);
+            }
+            if (distribution == DISTRIBUTION_COUNT || (colon != NULL && (end == colon + 1 || *end != '\0')) || cv_percent < 0) {
+                fprintf(stderr, "-d expects uniform|normal|lognormal|exponential[:cv percent], found %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            if (cv_percent > distribution_max_cv[distribution] || (distribution == DISTRIBUTION_EXPONENTIAL && cv_percent != 100)) {
+                fprintf(stderr, "-d %s supports a cv %s %d percent, found %s\n", distribution_names[distribution],
+                        distribution == DISTRIBUTION_EXPONENTIAL ? "of" : "up to", distribution_max_cv[distribution], optarg);
+                return EXIT_FAILURE;
+            }
+            sampler.distribution = distribution;
+            sampler.cv = cv_percent / 100.0;
+            break;
+        }
+        case 'S':
+            print_statistics = 1;
+            break;
+        case 't':
+            trace_path = optarg;
+            break;
+        case 's':
+            stream_path = optarg;
+            break;
+        case 'c':
+            core_count = atoi(optarg);
+            if (core_count < 1) {
+                fprintf(stderr, "number of cores must be positive\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b directory|manifest] [-j threads] [-c cores] [-s definition|-] [-t trace] [-m metrics.csv] [-q] [-S] [-p policy|all] [-f config] [-o key=value] [-w edits|-] [-r replications[:seed]] [-d distribution[:cv]] [-P profile.json]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
-                // set its enter to ready field to current time
-                ready_processes[idx].enter_to_ready = global_time; 
+    // read instruction set once, programs are read when a process uses them
+    load_instructions();
 
-                // increment its quantum counter
-                ready_processes[idx].quantum_counter++;
+    if (policy == -1) {
+        if (batch_source != NULL || stream_path != NULL || trace_path != NULL || metrics_path != NULL || print_latency_quantiles || print_statistics || replications > 0) {
+            fprintf(stderr, "-p all only prints averages of definition.txt, it cannot be combined with -b, -s, -t, -m, -q, -S or -r\n");
+            return EXIT_FAILURE;
+        }
+        return compare_policies(core_count);
+    }
+    if (what_if_path != NULL && (batch_source != NULL || stream_path != NULL || trace_path != NULL || metrics_path != NULL)) {
+        fprintf(stderr, "-w replays parts of the run again, it cannot be combined with -b, -s, -t or -m\n");
+        return EXIT_FAILURE;
+    }
+    if (replications > 0) {
+        if (batch_source != NULL || stream_path != NULL || trace_path != NULL || metrics_path != NULL || print_latency_quantiles || print_statistics || what_if_path != NULL) {
+            fprintf(stderr, "-r only prints intervals of the averages of definition.txt, it cannot be combined with -b, -s, -t, -m, -q, -S or -w\n");
+            return EXIT_FAILURE;
+        }
+        return run_monte_carlo(replications, &sampler, thread_count, core_count, policy);
+    }
 
-                // if quantum counter reaches 3, promote to gold
-                if(ready_processes[idx].quantum_counter >= 3) {
-                    strcpy(ready_processes[idx].type, "GOLD"); 
-                    ready_processes[idx].secondary_arrival = global_time; // update its secondary arrival
-                } 
+    if (batch_source != NULL) {
+        int status = run_batch(batch_source, thread_count, core_count, policy);
+#ifdef SCHEDULER_PROFILE
+        report_profile(&batch_profile, profile_path);
+#endif
+        return status;
+    }
 
-                // sort ready queue again as updates on preempted process may change things
-                qsort(ready_processes, ready_process_count, sizeof(Process), cmp);
+    Simulation simulation;
+    Simulation *sim = &simulation;
+    init_simulation(sim, core_count);
+    sim->policy = policy;
+
+    struct timespec load_start, run_start, run_end;
+    clock_gettime(CLOCK_MONOTONIC, &load_start);
+    DefinitionStream stream;
+    if (stream_path != NULL) {
+        if (open_stream(&stream, stream_path) != 0) {
+            fprintf(stderr, "cannot open %s\n", stream_path);
+            exit(EXIT_FAILURE);
+        }
+        sim->stream = &stream;
+        sim->reuse_slots = 1;
+    } else {
+        PROFILE_START(load);
+        if (load_definition(sim, "definition.txt") != 0) {
+            exit(EXIT_FAILURE);
+        }
+        PROFILE_STOP(sim, load);
+    }
+    TraceWriter *trace = NULL;
+    if (trace_path != NULL) {
+        trace = malloc(sizeof(TraceWriter));
+        if (trace == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        if (open_trace(trace, trace_path) != 0) {
+            fprintf(stderr, "cannot create %s\n", trace_path);
+            exit(EXIT_FAILURE);
+        }
+        sim->trace = trace;
+    }
+    CheckpointLog checkpoints = {NULL, 0, 0, 0};
+    if (what_if_path != NULL) {
+        sim->checkpoints = &checkpoints;
+    }
+    Metrics metrics;
+    FILE *metrics_file = NULL;
+    if (metrics_path != NULL || print_latency_quantiles) {
+        if (metrics_path != NULL) {
+            metrics_file = fopen(metrics_path, "w");
+            if (metrics_file == NULL) {
+                fprintf(stderr, "cannot create %s\n", metrics_path);
+                exit(EXIT_FAILURE);
             }
-
         }
-        
-        // if there exist a process in ready queue
-        if (ready_process_count > 0) {
+        init_metrics(&metrics, metrics_file);
+        sim->metrics = &metrics;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    run_simulation(sim);
+    clock_gettime(CLOCK_MONOTONIC, &run_end);
+    if (stream_path != NULL) {
+        close_stream(&stream);
+    }
+    if (trace != NULL) {
+        close_trace(trace);
+        free(trace);
+    }
 
-            // excute first process in the sorted ready queue
-            execute_process(); 
-        
-        // else increment current time 
-        } else {
-            global_time += 1; 
-        } 
-        
-    }  
-    
     // after all processes in the system terminated 
+    float avg_waiting_time, avg_turnaround_time;
+    compute_averages(sim, &avg_waiting_time, &avg_turnaround_time);
 
-    int turnaround_time = 0; // total turaround time of all processes
-    int waiting_time = 0; // total waiting time of all processes
-
-    // iterate over exited processes array
-    for(int i = 0; i < exited_process_count; i++) {
-        
-        // Turnaround time = Time of Completion - Time Of Arrival
-        turnaround_time += (exited_processes[i].completion_time - exited_processes[i].arrival_time);
-
-        // Waiting Time = Turnaround Time - Burst Time
-        waiting_time += (exited_processes[i].completion_time - exited_processes[i].arrival_time) - exited_processes[i].duration; 
+    // print them as integer or if floating number use 1 digit after decimal point
+    print_average(stdout, avg_waiting_time, '\n');
+    print_average(stdout, avg_turnaround_time, '\n');
+    if (print_latency_quantiles) {
+        print_quantiles(stdout, &metrics);
+    }
+    if (metrics_file != NULL) {
+        fclose(metrics_file);
     }
 
-    // take averages
-    float avg_waiting_time = (float)waiting_time / exited_process_count;
-    float avg_turnaround_time = (float)turnaround_time / exited_process_count;
+    // statistics of the run, in streaming mode reading the definition file is part of the run time
+    if (print_statistics) {
+        long long dispatches = 0;
+        for (int c = 0; c < core_count; c++) {
+            dispatches += sim->cores[c].context_switches;
+        }
+        double load_seconds = (run_start.tv_sec - load_start.tv_sec) + (run_start.tv_nsec - load_start.tv_nsec) / 1e9;
+        double run_seconds = (run_end.tv_sec - run_start.tv_sec) + (run_end.tv_nsec - run_start.tv_nsec) / 1e9;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        fprintf(stderr, "processes %d events %lld dispatches %lld load_ms %.1f run_ms %.1f events_per_s %.0f ns_per_dispatch %.1f peak_rss_kb %ld\n",
+                sim->exited_process_count, sim->events, dispatches, load_seconds * 1e3, run_seconds * 1e3,
+                run_seconds > 0 ? sim->events / run_seconds : 0, dispatches > 0 ? run_seconds * 1e9 / dispatches : 0, usage.ru_maxrss);
+    }
 
-    
-    // print them as integer or if floating number use 1 digit after decimal point
-    if (fmod(avg_waiting_time, 1) == 0) {
-        printf("%d\n", (int)avg_waiting_time);
-    } else {
-        printf("%.1f\n", avg_waiting_time);
+    // with more than one core, print accounting of each core and the time the last process terminated
+    if (core_count > 1) {
+        for (int c = 0; c < core_count; c++) {
+            Core *core = &sim->cores[c];
+            printf("core %d busy_time %d context_switches %d context_switch_time %d steals %d\n", c, core->busy_time, core->context_switches, core->context_switch_time, core->steals);
+        }
+        printf("makespan %d\n", sim->makespan);
     }
 
-    if (fmod(avg_turnaround_time, 1) == 0) {
-        printf("%d\n", (int)avg_turnaround_time);
-    } else {
-        printf("%.1f\n", avg_turnaround_time);
+    // with I/O devices, print how busy the CPU and each device were and the number of processes terminated per time unit
+    if (device_count > 0) {
+        long long busy_time = 0;
+        for (int c = 0; c < core_count; c++) {
+            busy_time += sim->cores[c].busy_time;
+        }
+        double makespan = sim->makespan > 0 ? sim->makespan : 1;
+        printf("cpu_utilization %.3f throughput %.6f\n", busy_time / (makespan * core_count), sim->exited_process_count / makespan);
+        for (int d = 0; d < device_count; d++) {
+            DeviceQueue *device = &sim->devices[d];
+            printf("device %s busy_time %d requests %d utilization %.3f\n", devices[d].name, device->busy_time, device->requests, device->busy_time / makespan);
+        }
     }
 
+    // what-if edits are simulated from the checkpoints of the run
+    int status = EXIT_SUCCESS;
+    if (what_if_path != NULL) {
+        status = run_what_if(sim, what_if_path);
+        free_checkpoints(&checkpoints);
+    }
 
-    /* for(int i = 0; i < process_count; i++) {
-        printProcess(&processes[i]); 
+    /* for(int i = 0; i < sim->processes.count; i++) {
+        printProcess(sim, i); 
     } */ 
 
-    return 0; 
-}
\ No newline at end of file
+#ifdef SCHEDULER_PROFILE
+    report_profile(&sim->profile, profile_path);
+#endif
+    free_simulation(sim);
+    return status; 
+}
+
+#endif
@@ -0,0 +1,35 @@
+#!/bin/sh
+# batch mode test, run from the repository root with make test
+# a definition file naming a missing or invalid program is skipped with an error, the rows of the other files are still printed
+
+set -e
+
+root=$(pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cp instructions.txt P*.txt "$work"
+mkdir "$work/batch"
+cp definition.txt "$work/batch/def1.txt"
+printf 'P1 1 0 GOLD NOPE\n' > "$work/batch/def2.txt"
+printf 'P1 1 0 GOLD BAD\n' > "$work/batch/def3.txt"
+printf 'exit\nnot_an_instruction\n' > "$work/BAD.txt"
+cp definition.txt "$work/batch/def4.txt"
+
+averages=$(cd "$work" && cp batch/def1.txt definition.txt && "$root/scheduler" | head -2 | paste -s -d ' ' -)
+expected=$(printf 'batch/def1.txt %s\nbatch/def4.txt %s' "$averages" "$averages")
+for threads in 1 4; do
+    rows=$(cd "$work" && "$root/scheduler" -b batch -j "$threads" 2>"$work/errors")
+    if [ "$rows" != "$expected" ]; then
+        echo "batch -j $threads: expected rows"
+        echo "$expected"
+        echo "found"
+        echo "$rows"
+        exit 1
+    fi
+    if ! grep -q "def2.txt:1: cannot open NOPE.txt" "$work/errors" || ! grep -q "def3.txt:1: unknown instruction" "$work/errors"; then
+        echo "batch -j $threads: missing errors"
+        cat "$work/errors"
+        exit 1
+    fi
+done
+echo "batch ok"
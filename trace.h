@@ -0,0 +1,111 @@
+// binary trace of scheduling events, written by scheduler with -t option and read by tracereader
+// a trace starts with TRACE_MAGIC, events follow it and a footer indexing them ends it
+// an event is its kind byte followed by varints: time delta from the previous event (zigzag encoded, events of
+// different cores are not in time order), core index and process slot
+// an arrival also holds the process name, a promotion the new type name and a block the device name, as a length byte and the characters
+// before its name an arrival holds one more varint, the distance in bytes back to the previous arrival in its slot, 0 for the first one
+// slots of exited processes are reused in streaming mode, so an arrival binds its slot to a new process
+// the footer is written when the trace is closed, its numbers are 64 bit little endian:
+// - a TraceBlock for every buffer of events the scheduler flushed, so a reader decodes only the blocks overlapping a time range
+// - for every slot the offset of its last arrival (0 if it has none), following the arrival links from it gives the
+//   name a slot had at any offset without decoding the events before it
+// - the trailer: offset of the footer, number of blocks, number of slots and TRACE_INDEX_MAGIC
+// a trace without the trailer (the scheduler did not finish) is still read, sequentially
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRACE_MAGIC "SCHTRC2\n"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_INDEX_MAGIC "SCHIDX1\n"
+#define TRACE_TRAILER_SIZE (3 * 8 + 8)
+
+// longest encoded event: kind, four varints of a 64 bit value and a name of up to 255 characters
+#define TRACE_MAX_EVENT_SIZE (1 + 4 * 10 + 1 + 255)
+
+// size of process name arrays, names have at most 9 characters so tracereader keeps just as much per slot
+#define PROCESS_NAME_SIZE 10
+
+// index entry of a block of consecutive events in the footer
+typedef struct {
+    int64_t offset; // offset of the first event
+    int64_t base_time; // time of the event before the first one, the delta of the first event is relative to it
+    int64_t min_time; // smallest time of the events
+    int64_t max_time; // largest time of the events
+} TraceBlock;
+
+#define TRACE_BLOCK_SIZE (4 * 8)
+
+typedef enum {
+    TRACE_ARRIVAL, // process is added to the ready queue of the core
+    TRACE_CONTEXT_SWITCH, // core starts a context switch to the process
+    TRACE_DISPATCH, // process starts running on the core after the context switch
+    TRACE_PREEMPTION, // process is preempted before its quantum ended
+    TRACE_PROMOTION, // process is promoted to a new type
+    TRACE_EXIT, // process executed its exit instruction
+    TRACE_BLOCK, // process left the CPU for an I/O request
+    TRACE_WAKEUP, // I/O request completed and the process is added to the ready queue of the core
+    TRACE_KIND_COUNT
+} TraceKind;
+
+static const char *const trace_kind_names[TRACE_KIND_COUNT] = {
+    "arrival", "context_switch", "dispatch", "preemption", "promotion", "exit", "block", "wakeup"
+};
+
+// returns 1 if events of the kind hold a name after their varints
+static inline int trace_kind_has_text(int kind) {
+    return kind == TRACE_ARRIVAL || kind == TRACE_PROMOTION || kind == TRACE_BLOCK;
+}
+
+// writes value as unsigned LEB128 varint to out, returns the number of bytes written
+static inline int trace_put_varint(uint8_t *out, uint64_t value) {
+    int n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// reads a varint from in into value, returns the byte after it or NULL if it does not end before end
+static inline const uint8_t *trace_get_varint(const uint8_t *in, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        uint8_t byte = *in++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;
+}
+
+// writes value to out as 8 bytes in little endian order
+static inline void trace_put_u64(uint8_t *out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t trace_get_u64(const uint8_t *in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+// zigzag encoding maps small negative deltas to small unsigned values
+static inline uint64_t trace_zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t trace_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+#endif
@@ -0,0 +1,275 @@
+// necessary headers
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include "trace.h"
+
+// names of processes by slot, an arrival binds a slot to the name of the arriving process
+// an empty name is not known yet, it is looked up in the footer when the slot is first needed after seeking
+typedef struct {
+    char (*name)[PROCESS_NAME_SIZE];
+    int capacity;
+} SlotNames;
+
+// a decoded event
+typedef struct {
+    uint8_t kind;
+    int64_t delta; // time delta from the previous event
+    uint64_t core;
+    uint64_t p; // process slot
+    uint64_t link; // distance back to the previous arrival in the slot, arrivals only
+    char text[256]; // name of an arrival, type of a promotion or device of a block
+} TraceEvent;
+
+// a mapped trace, the footer fields are 0 if it has no footer
+typedef struct {
+    const char *path;
+    const uint8_t *data;
+    size_t events_end; // offset of the footer or the size of the trace
+    const uint8_t *blocks; // index entries, see TraceBlock
+    uint64_t block_count;
+    const uint8_t *last_arrival; // offset of the last arrival of each slot
+    uint64_t slot_count;
+} Trace;
+
+// decodes the event at offset, exits if it is invalid
+// returns the offset of the next event
+size_t decode_event(const Trace *trace, size_t offset, TraceEvent *event) {
+    const uint8_t *in = trace->data + offset;
+    const uint8_t *end = trace->data + trace->events_end;
+    uint64_t delta;
+    event->kind = *in++;
+    event->link = 0;
+    event->text[0] = '\0';
+    if (event->kind >= TRACE_KIND_COUNT
+        || (in = trace_get_varint(in, end, &delta)) == NULL
+        || (in = trace_get_varint(in, end, &event->core)) == NULL
+        || (in = trace_get_varint(in, end, &event->p)) == NULL
+        || (event->kind == TRACE_ARRIVAL && (in = trace_get_varint(in, end, &event->link)) == NULL)
+        || event->p > INT_MAX || event->link > offset) {
+        in = NULL;
+    } else if (trace_kind_has_text(event->kind)) {
+        if (in == end || end - in - 1 < *in || (event->kind == TRACE_ARRIVAL && *in >= PROCESS_NAME_SIZE)) {
+            in = NULL;
+        } else {
+            int len = *in++;
+            memcpy(event->text, in, len);
+            event->text[len] = '\0';
+            in += len;
+        }
+    }
+    if (in == NULL) {
+        fprintf(stderr, "%s: invalid event at offset %zu\n", trace->path, offset);
+        exit(EXIT_FAILURE);
+    }
+    event->delta = trace_unzigzag(delta);
+    return in - trace->data;
+}
+
+// returns the name array entry of slot p, growing the array if needed
+char *slot_name(SlotNames *slots, uint64_t p) {
+    if ((int)p >= slots->capacity) {
+        int capacity = slots->capacity ? slots->capacity : 16;
+        while (capacity <= (int)p) {
+            capacity *= 2;
+        }
+        slots->name = realloc(slots->name, capacity * sizeof(*slots->name));
+        if (slots->name == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        memset(slots->name + slots->capacity, 0, (capacity - slots->capacity) * sizeof(*slots->name));
+        slots->capacity = capacity;
+    }
+    return slots->name[p];
+}
+
+// sets name to the name slot p had at offset, following the arrival links back from the last arrival of the slot
+// "?" if the slot had no arrival before offset
+void find_slot_name(const Trace *trace, uint64_t p, size_t offset, char *name) {
+    uint64_t arrival = p < trace->slot_count ? trace_get_u64(trace->last_arrival + 8 * p) : 0;
+    TraceEvent event;
+    while (arrival >= offset) {
+        decode_event(trace, arrival, &event);
+        arrival = event.link != 0 ? arrival - event.link : 0;
+    }
+    if (arrival == 0) {
+        strcpy(name, "?");
+        return;
+    }
+    decode_event(trace, arrival, &event);
+    if (event.kind != TRACE_ARRIVAL || event.p != p) {
+        fprintf(stderr, "%s: invalid arrival link at offset %llu\n", trace->path, (unsigned long long)arrival);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(name, event.text);
+}
+
+// reads the footer of the trace if it has one, exits if it is invalid
+void read_footer(Trace *trace, size_t size) {
+    trace->events_end = size;
+    const uint8_t *trailer = trace->data + size - TRACE_TRAILER_SIZE;
+    if (size < TRACE_MAGIC_SIZE + TRACE_TRAILER_SIZE || memcmp(trailer + 24, TRACE_INDEX_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+        return;
+    }
+    uint64_t footer = trace_get_u64(trailer);
+    uint64_t block_count = trace_get_u64(trailer + 8);
+    uint64_t slot_count = trace_get_u64(trailer + 16);
+    if (footer < TRACE_MAGIC_SIZE || footer > size - TRACE_TRAILER_SIZE || block_count > size / TRACE_BLOCK_SIZE || slot_count > size / 8
+        || footer + block_count * TRACE_BLOCK_SIZE + slot_count * 8 != size - TRACE_TRAILER_SIZE) {
+        fprintf(stderr, "%s: invalid footer\n", trace->path);
+        exit(EXIT_FAILURE);
+    }
+    trace->events_end = footer;
+    trace->blocks = trace->data + footer;
+    trace->block_count = block_count;
+    trace->last_arrival = trace->blocks + block_count * TRACE_BLOCK_SIZE;
+    trace->slot_count = slot_count;
+    for (uint64_t i = 0; i < block_count; i++) {
+        uint64_t offset = trace_get_u64(trace->blocks + i * TRACE_BLOCK_SIZE);
+        if (offset < TRACE_MAGIC_SIZE || offset >= footer) {
+            fprintf(stderr, "%s: invalid footer\n", trace->path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (uint64_t p = 0; p < slot_count; p++) {
+        if (trace_get_u64(trace->last_arrival + 8 * p) >= footer) {
+            fprintf(stderr, "%s: invalid footer\n", trace->path);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// returns the index entry i of the trace
+TraceBlock trace_block(const Trace *trace, uint64_t i) {
+    const uint8_t *entry = trace->blocks + i * TRACE_BLOCK_SIZE;
+    return (TraceBlock){(int64_t)trace_get_u64(entry), (int64_t)trace_get_u64(entry + 8),
+        (int64_t)trace_get_u64(entry + 16), (int64_t)trace_get_u64(entry + 24)};
+}
+
+/* main function maps a trace written by scheduler -t and prints its events whose times are in [from, to], one per line
+as time, core, event kind, process name and the new type for promotions or the device for blocks
+-c prints the number of events of each kind in the range instead, -p keeps only the events of the process with given name
+only the blocks of events from the first one to the last one overlapping [from, to] in the footer are decoded */
+int main(int argc, char *argv[]) {
+
+    int count_only = 0; // -c option
+    const char *process = NULL; // -p option
+    int option;
+    while ((option = getopt(argc, argv, "cp:")) != -1) {
+        switch (option) {
+        case 'c':
+            count_only = 1;
+            break;
+        case 'p':
+            process = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c] [-p process] trace [from [to]]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-c] [-p process] trace [from [to]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *path = argv[optind];
+    long long from = optind + 1 < argc ? atoll(argv[optind + 1]) : LLONG_MIN;
+    long long to = optind + 2 < argc ? atoll(argv[optind + 2]) : LLONG_MAX;
+
+    // map the whole trace, events are decoded in place
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return EXIT_FAILURE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < TRACE_MAGIC_SIZE) {
+        fprintf(stderr, "%s is not a trace\n", path);
+        return EXIT_FAILURE;
+    }
+    size_t size = st.st_size;
+    const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "cannot map %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (memcmp(data, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "%s is not a trace\n", path);
+        return EXIT_FAILURE;
+    }
+    Trace trace = {path, data, 0, NULL, 0, NULL, 0};
+    read_footer(&trace, size);
+
+    // events from offset to stop are decoded, time is the time before the first of them
+    size_t offset = TRACE_MAGIC_SIZE;
+    size_t stop = trace.events_end;
+    long long time = 0;
+    if (trace.block_count > 0 && (from != LLONG_MIN || to != LLONG_MAX)) {
+        uint64_t first = trace.block_count, last = 0;
+        for (uint64_t i = 0; i < trace.block_count; i++) {
+            TraceBlock block = trace_block(&trace, i);
+            if (block.max_time >= from && block.min_time <= to) {
+                first = first < i ? first : i;
+                last = i;
+            }
+        }
+        if (first == trace.block_count) {
+            stop = offset;
+        } else {
+            TraceBlock block = trace_block(&trace, first);
+            offset = block.offset;
+            time = block.base_time;
+            stop = last + 1 < trace.block_count ? (size_t)trace_block(&trace, last + 1).offset : trace.events_end;
+        }
+    }
+    size_t start = offset;
+    madvise((void *)(data + start / 4096 * 4096), stop - start / 4096 * 4096, MADV_SEQUENTIAL);
+
+    SlotNames slots = {NULL, 0};
+    long long counts[TRACE_KIND_COUNT] = {0};
+    int need_names = !count_only || process != NULL;
+    TraceEvent event;
+    while (offset < stop) {
+        size_t next = decode_event(&trace, offset, &event);
+        time += event.delta;
+        char *name = slot_name(&slots, event.p);
+        if (event.kind == TRACE_ARRIVAL) {
+            strcpy(name, event.text);
+        }
+        offset = next;
+
+        if (time < from || time > to) {
+            continue;
+        }
+        if (need_names && name[0] == '\0') {
+            // the slot had no arrival since start, so it has the name of its last arrival before it
+            find_slot_name(&trace, event.p, start, name);
+        }
+        if (process != NULL && strcmp(name, process) != 0) {
+            continue;
+        }
+        counts[event.kind]++;
+        if (!count_only) {
+            int show_text = event.kind == TRACE_PROMOTION || event.kind == TRACE_BLOCK;
+            printf("%lld %llu %s %s%s%s\n", time, (unsigned long long)event.core, trace_kind_names[event.kind], name, show_text ? " " : "", show_text ? event.text : "");
+        }
+    }
+
+    if (count_only) {
+        for (int k = 0; k < TRACE_KIND_COUNT; k++) {
+            printf("%s %lld\n", trace_kind_names[k], counts[k]);
+        }
+    }
+
+    munmap((void *)data, size);
+    free(slots.name);
+    return EXIT_SUCCESS;
+}